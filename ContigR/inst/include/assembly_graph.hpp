@@ -0,0 +1,389 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+
+#include "contigs.hpp"
+#include "overlaps.hpp"
+
+using namespace std;
+
+// Loaders of assembly graphs (GFA1 and SPAdes FASTG).
+// Assemblers already know which contigs are adjacent, so both
+// `ContigCollection` and `OverlapCollection` are filled straight from the graph
+// and `detect_adjacent_contigs` does not have to be run.
+
+struct GraphLink {
+    std::string from;  // имя первого сегмента
+    bool from_fwd;     // ориентация первого сегмента ('+')
+    std::string to;    // имя второго сегмента
+    bool to_fwd;       // ориентация второго сегмента ('+')
+    int ovl_len;       // длина перекрытия
+};
+
+template <typename LineFunc>
+bool _for_each_file_line(const std::string& filepath, LineFunc func) {
+    // Function calls `func` for every line of a plain or gzip-compressed file.
+    CompressionFormat format = detect_compression(filepath);
+    if (format == BGZF_COMPRESSED) {
+        BgzfSource source(filepath);
+        LineReader<BgzfSource> lines(source);
+        std::string_view line;
+        while (lines.next_line(line)) func(line);
+        return true;
+    }
+    if (format == GZIP_COMPRESSED) {
+        GzipSource source(filepath);
+        if (!source.is_open()) return false;
+        LineReader<GzipSource> lines(source);
+        std::string_view line;
+        while (lines.next_line(line)) func(line);
+        return true;
+    }
+    FileSource source(filepath);
+    if (!source.is_open()) return false;
+    LineReader<FileSource> lines(source);
+    std::string_view line;
+    while (lines.next_line(line)) func(line);
+    return true;
+}
+
+std::vector<std::string_view> _split_fields(std::string_view line, char sep) {
+    std::vector<std::string_view> fields;
+    size_t begin = 0;
+    while (true) {
+        size_t end = line.find(sep, begin);
+        fields.push_back(line.substr(begin, end == std::string_view::npos ? std::string_view::npos : end - begin));
+        if (end == std::string_view::npos) break;
+        begin = end + 1;
+    }
+    return fields;
+}
+
+int _parse_cigar_overlap(std::string_view cigar) {
+    // Function returns the length of the overlap on the first segment
+    // described by a GFA CIGAR string (M, =, X and D operations), 0 if unknown.
+    // Lengths too long to be stored are returned as MAX_PACKED_OVERLAP_LEN + 1.
+    const int64_t too_long = MAX_PACKED_OVERLAP_LEN + 1;
+    int64_t ovl_len = 0;
+    int64_t num = 0;
+    for (char c : cigar) {
+        if (c >= '0' && c <= '9') {
+            num = std::min(num * 10 + (c - '0'), too_long);
+        } else {
+            if (c == 'M' || c == '=' || c == 'X' || c == 'D') {
+                ovl_len = std::min(ovl_len + num, too_long);
+            } else if (c == '*') {
+                return 0;
+            }
+            num = 0;
+        }
+    }
+    return static_cast<int>(ovl_len);
+}
+
+float _parse_fastg_coverage(std::string_view name) {
+    // SPAdes names look like `EDGE_1_length_57_cov_3.5`
+    size_t pos = name.rfind("_cov_");
+    if (pos == std::string_view::npos) {
+        return 0;
+    }
+    return std::strtof(std::string(name.substr(pos + 5)).c_str(), nullptr);
+}
+
+uint64_t _overlap_key(const Overlap& ovl) {
+    return (static_cast<uint64_t>(ovl.contig_i) << 34) | (static_cast<uint64_t>(ovl.terminus_i) << 32) |
+           (static_cast<uint64_t>(ovl.contig_j) << 2) | static_cast<uint64_t>(ovl.terminus_j);
+}
+
+void _add_link_overlaps(std::vector<Overlap>& overlaps, std::unordered_set<uint64_t>& seen,
+                        ContigIndex a, bool a_fwd, ContigIndex b, bool b_fwd, int ovl_len) {
+    // Function converts an oriented link `a -> b` into the `Overlap` record
+    // that `detect_adjacent_contigs` would emit for the same adjacency.
+    if (!a_fwd && !b_fwd) {
+        // a- -> b- is the same adjacency as b+ -> a+
+        std::swap(a, b);
+        a_fwd = b_fwd = true;
+    }
+
+    Overlap record(a, END, b, START, ovl_len);
+    if (a_fwd && !b_fwd) {
+        // End of `a` matches the reverse-complement end of `b`
+        record = Overlap(a, END, b, RCEND, ovl_len);
+    } else if (!a_fwd && b_fwd) {
+        // Start of `b` matches the reverse-complement start of `a`
+        record = Overlap(b, START, a, RCSTART, ovl_len);
+    }
+
+    // The same adjacency may be listed from either side: remember both records,
+    // keep one (`OverlapCollection` derives the other)
+    if (seen.insert(_overlap_key(record)).second) {
+        seen.insert(_overlap_key(mirrored_overlap(record)));
+        overlaps.push_back(record);
+    }
+}
+
+void _add_graph_links(const std::vector<GraphLink>& links,
+                      const std::unordered_map<std::string, ContigIndex>& name_to_index,
+                      size_t num_contigs, OverlapCollection& overlap_collection) {
+    std::vector<Overlap> overlaps;
+    std::unordered_set<uint64_t> seen;
+    size_t num_unknown = 0;
+    size_t num_no_overlap = 0;
+    size_t num_too_long = 0;
+
+    for (const GraphLink& link : links) {
+        auto from_it = name_to_index.find(link.from);
+        auto to_it = name_to_index.find(link.to);
+        if (from_it == name_to_index.end() || to_it == name_to_index.end()) {
+            num_unknown++;
+            continue;
+        }
+        if (link.ovl_len <= 0) {
+            num_no_overlap++;
+            continue;
+        }
+        if (link.ovl_len > MAX_PACKED_OVERLAP_LEN) {
+            num_too_long++;
+            continue;
+        }
+        _add_link_overlaps(overlaps, seen, from_it->second, link.from_fwd,
+                           to_it->second, link.to_fwd, link.ovl_len);
+    }
+
+    std::vector<std::vector<Overlap>> buffers(1);
+    buffers[0].swap(overlaps);
+    overlap_collection = OverlapCollection(num_contigs, buffers);
+
+    if (num_unknown > 0) {
+        std::cerr << "Warning: " << num_unknown << " links refer to unknown segments and were skipped" << std::endl;
+    }
+    if (num_no_overlap > 0) {
+        std::cerr << "Warning: " << num_no_overlap << " links without overlap length were skipped" << std::endl;
+    }
+    if (num_too_long > 0) {
+        std::cerr << "Warning: " << num_too_long << " links with overlaps longer than "
+                  << MAX_PACKED_OVERLAP_LEN << " bp were skipped" << std::endl;
+    }
+}
+
+bool load_gfa(const std::string& filepath, int maxk,
+              ContigCollection& contig_collection, OverlapCollection& overlap_collection) {
+    // Function loads segments (S lines) as contigs and links (L lines) as overlaps
+    // from a GFA1 file. Coverage is taken from `dp`/`DP` tags, or from `KC`/`RC` divided by length.
+    std::unordered_map<std::string, ContigIndex> name_to_index;
+    std::vector<GraphLink> links;
+    ContigBuilder builder(maxk);
+
+    bool is_open = _for_each_file_line(filepath, [&](std::string_view line) {
+        if (line.size() < 2 || line[1] != '\t' || (line[0] != 'S' && line[0] != 'L')) {
+            return;
+        }
+        std::vector<std::string_view> fields = _split_fields(line, '\t');
+
+        if (line[0] == 'S' && fields.size() >= 3) {
+            std::string name(fields[1]);
+            std::string_view seq = fields[2];
+
+            float depth = -1;
+            long long count = -1;
+            int length = seq == "*" ? 0 : static_cast<int>(seq.length());
+            for (size_t f = 3; f < fields.size(); ++f) {
+                std::string_view tag = fields[f];
+                if (tag.size() < 5) continue;
+                std::string value(tag.substr(5));
+                if (tag.substr(0, 5) == "dp:f:" || tag.substr(0, 5) == "DP:f:") {
+                    depth = std::strtof(value.c_str(), nullptr);
+                } else if (tag.substr(0, 5) == "KC:i:" || (tag.substr(0, 5) == "RC:i:" && count < 0)) {
+                    count = std::strtoll(value.c_str(), nullptr, 10);
+                } else if (tag.substr(0, 5) == "LN:i:" && seq == "*") {
+                    length = std::atoi(value.c_str());
+                }
+            }
+
+            if (seq == "*") {
+                // No sequence in the graph: termini and GC content are unknown
+                contig_collection.push_back(Contig(name, length, 0, 0, "", "", "", ""));
+            } else {
+                builder.begin(name);
+                builder.add_line(seq);
+                contig_collection.push_back(builder.build());
+            }
+            if (depth >= 0) {
+                contig_collection.back().cov = depth;
+            } else if (count >= 0 && length > 0) {
+                contig_collection.back().cov = static_cast<float>(count) / length;
+            }
+            name_to_index[name] = static_cast<ContigIndex>(contig_collection.size() - 1);
+        } else if (line[0] == 'L' && fields.size() >= 6) {
+            links.push_back(GraphLink{std::string(fields[1]), fields[2] == "+",
+                                      std::string(fields[3]), fields[4] == "+",
+                                      _parse_cigar_overlap(fields[5])});
+        }
+    });
+
+    if (!is_open) {
+        std::cerr << "Error: Unable to open file for reading: " << filepath << std::endl;
+        return false;
+    }
+
+    _add_graph_links(links, name_to_index, contig_collection.size(), overlap_collection);
+    return true;
+}
+
+bool load_fastg(const std::string& filepath, int k, int maxk,
+                ContigCollection& contig_collection, OverlapCollection& overlap_collection) {
+    // Function loads a SPAdes FASTG file. Headers look like
+    //   >EDGE_1_length_57_cov_3.5:EDGE_2_length_80_cov_4.1',EDGE_3_length_99_cov_2.0;
+    // where a trailing `'` denotes the reverse-complement edge. FASTG does not store
+    // overlap lengths: SPAdes edges overlap by exactly `k`, the assembly k-mer size.
+    // Contigs are built from the forward records only.
+    std::unordered_map<std::string, ContigIndex> name_to_index;
+    std::vector<GraphLink> links;
+    ContigBuilder builder(std::max(k, maxk));
+    bool in_forward_record = false;
+
+    auto finish_record = [&]() {
+        if (in_forward_record && !builder.empty()) {
+            contig_collection.push_back(builder.build());
+            contig_collection.back().cov = _parse_fastg_coverage(contig_collection.back().name);
+            name_to_index[contig_collection.back().name] = static_cast<ContigIndex>(contig_collection.size() - 1);
+        }
+        in_forward_record = false;
+    };
+
+    auto parse_edge = [](std::string_view edge, std::string& name, bool& fwd) {
+        fwd = edge.empty() || edge.back() != '\'';
+        name.assign(fwd ? edge : edge.substr(0, edge.size() - 1));
+    };
+
+    bool is_open = _for_each_file_line(filepath, [&](std::string_view line) {
+        if (line.empty()) {
+            return;
+        }
+        if (line[0] != '>') {
+            if (in_forward_record) builder.add_line(line);
+            return;
+        }
+
+        finish_record();
+
+        std::string_view header = line.substr(1);
+        if (!header.empty() && header.back() == ';') {
+            header.remove_suffix(1);
+        }
+        size_t colon = header.find(':');
+        std::string name;
+        bool fwd;
+        parse_edge(header.substr(0, colon), name, fwd);
+
+        if (fwd) {
+            builder.begin(name);
+            in_forward_record = true;
+        }
+        if (colon != std::string_view::npos) {
+            for (std::string_view next : _split_fields(header.substr(colon + 1), ',')) {
+                GraphLink link{name, fwd, "", true, k};
+                parse_edge(next, link.to, link.to_fwd);
+                links.push_back(link);
+            }
+        }
+    });
+    finish_record();
+
+    if (!is_open) {
+        std::cerr << "Error: Unable to open file for reading: " << filepath << std::endl;
+        return false;
+    }
+
+    _add_graph_links(links, name_to_index, contig_collection.size(), overlap_collection);
+    return true;
+}
+
+bool is_assembly_graph(const std::string& filepath) {
+    // Function returns true for GFA and FASTG files (optionally gzip-compressed).
+    std::string path = filepath;
+    if (path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0) {
+        path.erase(path.size() - 3);
+    }
+    size_t dot = path.rfind('.');
+    std::string ext = dot == std::string::npos ? "" : path.substr(dot);
+    return ext == ".gfa" || ext == ".gfa1" || ext == ".fastg";
+}
+
+bool load_assembly_graph(const std::string& filepath, int k, int maxk,
+                         ContigCollection& contig_collection, OverlapCollection& overlap_collection) {
+    // Function selects the loader by file extension. `k` is used only for FASTG.
+    std::string path = filepath;
+    if (path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0) {
+        path.erase(path.size() - 3);
+    }
+    if (path.size() > 6 && path.compare(path.size() - 6, 6, ".fastg") == 0) {
+        return load_fastg(filepath, k, maxk, contig_collection, overlap_collection);
+    }
+    return load_gfa(filepath, maxk, contig_collection, overlap_collection);
+}
+
+int _find_overlap_for_termini(const ContigTermini& ci, Terminus ti, const ContigTermini& cj, Terminus tj, int len) {
+    // Function checks the overlap of exactly `len` bp described by the terminus pair
+    // with the same `find_overlap_*` call `detect_adjacent_contigs` uses for it.
+    // Returns -1 for terminus pairs that are never emitted.
+    if (ti == START && tj == END) return find_overlap_e2s(cj.end, ci.start, len, len);
+    if (ti == END && tj == START) return find_overlap_e2s(ci.end, cj.start, len, len);
+    if (ti == START && tj == RCSTART) return find_overlap_e2s(cj.rcstart, ci.start, len, len);
+    if (ti == END && tj == RCEND) return find_overlap_e2s(ci.end, cj.rcend, len, len);
+    if (ti == START && tj == START) return find_overlap_s2s(ci.start, cj.start, len, len);
+    if (ti == END && tj == END) return find_overlap_e2e(ci.end, cj.end, len, len);
+    if (ti == START && tj == RCEND) return find_overlap_s2s(ci.start, cj.rcend, len, len);
+    if (ti == RCEND && tj == START) return find_overlap_s2s(cj.start, ci.rcend, len, len);
+    if (ti == END && tj == RCSTART) return find_overlap_e2e(ci.end, cj.rcstart, len, len);
+    if (ti == RCSTART && tj == END) return find_overlap_e2e(cj.end, ci.rcstart, len, len);
+    return -1;
+}
+
+size_t verify_graph_overlaps(const ContigCollection& contig_collection,
+                             const OverlapCollection& overlap_collection,
+                             size_t max_checks = 1000) {
+    // Function spot-checks overlaps loaded from an assembly graph against
+    // the contig termini using `find_overlap_*`. About `max_checks` contigs,
+    // evenly spread over the collection, are checked.
+    // Returns the number of overlaps that could not be confirmed.
+    size_t num_contigs = contig_collection.size();
+    size_t stride = std::max<size_t>(1, num_contigs / std::max<size_t>(max_checks, 1));
+    size_t num_checked = 0;
+    size_t num_skipped = 0;
+    size_t num_failed = 0;
+
+    for (size_t i = 0; i < num_contigs; i += stride) {
+        for (const Overlap& ovl : overlap_collection[i]) {
+            ContigTermini ci = contig_collection.termini(ovl.contig_i);
+            ContigTermini cj = contig_collection.termini(ovl.contig_j);
+            // Termini are only `maxk` long, longer overlaps cannot be checked
+            int terminus_len = std::min({ci.start.length(), ci.end.length(), cj.start.length(), cj.end.length()});
+            if (ovl.ovl_len > terminus_len) {
+                num_skipped++;
+                continue;
+            }
+            num_checked++;
+            if (_find_overlap_for_termini(ci, ovl.terminus_i, cj, ovl.terminus_j, ovl.ovl_len) != ovl.ovl_len) {
+                num_failed++;
+                if (num_failed <= 10) {
+                    std::cerr << "Warning: overlap " << contig_collection.names()[ovl.contig_i] << " - "
+                              << contig_collection.names()[ovl.contig_j] << " of "
+                              << ovl.ovl_len << " bp is not confirmed by sequences" << std::endl;
+                }
+            }
+        }
+    }
+
+    std::cout << "Verified " << num_checked << " overlaps: " << num_failed << " not confirmed, "
+              << num_skipped << " longer than termini skipped" << std::endl;
+    return num_failed;
+}
@@ -12,15 +12,11 @@ float _calc_multiplty_by_coverage(float curr_coverage, float first_contig_covera
     return curr_coverage / first_contig_coverage;
 }
 
-float _calc_multiply_by_overlaps(const std::vector<Overlap>& ovl_list) {
+float _calc_multiply_by_overlaps(int num_start_matches, int num_end_matches) {
     // Function for calculating multiplicity of a given contig
     // based on the number of overlaps of this contig.
-    // :param ovl_list: list of overlaps of current contig;
-
-    // Count overlaps associated with start
-    int num_start_matches = std::count_if(ovl_list.begin(), ovl_list.end(), is_start_match);
-    // Count overlaps associated with end
-    int num_end_matches = std::count_if(ovl_list.begin(), ovl_list.end(), is_end_match);
+    // :param num_start_matches: number of overlaps associated with start;
+    // :param num_end_matches: number of overlaps associated with end;
 
     // Obtain multiplicity based on the number of overlaps
     float multiplicity = std::max(1, std::min(num_start_matches, num_end_matches));
@@ -57,8 +53,9 @@ void assign_multiplicity(ContigCollection& contig_collection, const OverlapColle
             );
         } else {
             contig_collection[i].multplty = _calc_multiply_by_overlaps(
-                overlap_collection[i]
+                overlap_collection.start_degree(i),
+                overlap_collection.end_degree(i)
             );
         }
     }
-} 
\ No newline at end of file
+}
\ No newline at end of file
@@ -2,15 +2,23 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector> 
 #include <numeric>
 #include <cmath>
 #include <functional>
 #include <iostream> 
 #include <iomanip> // для форматирования вывода
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <tuple>
 
 #include "contigs.hpp"
 #include "overlaps.hpp"
+#include "quantile_sketch.hpp"
+#include "output_buffer.hpp"
+#include "columnar_output.hpp"
 
 using namespace std;
 
@@ -30,182 +38,294 @@ std::unordered_map<Terminus, std::string> KEY2WORD_MAP = {
     {RCEND, "rc-end"}
 };
 
+// The same, indexed by `Terminus`, for the buffered writers
+const std::string_view TERMINUS_LETTERS[4] = {"S", "rc_S", "E", "rc_E"};
+const std::string_view TERMINUS_WORDS[4] = {"start", "rc-start", "end", "rc-end"};
+
+const size_t COVERAGE_BLOCK_SIZE = 1 << 15;
+
 class CoverageCalculator {
 public:
-    CoverageCalculator(const ContigCollection& contig_collection) {
-        _coverages = _filter_non_none_covs(contig_collection);
+    // Streaming coverage statistics: min, max, mean and a KLL sketch for the median and
+    // other percentiles, in constant memory. NaN coverages (unknown) are skipped.
+    // Calculators of parts of the contigs (e.g. one per thread) are combined with `merge`.
+    CoverageCalculator() : _min_cov(std::numeric_limits<float>::infinity()),
+        _max_cov(-std::numeric_limits<float>::infinity()), _sum_cov(0.0), _num_covs(0) {}
+
+    CoverageCalculator(const ContigCollection& contig_collection) : CoverageCalculator() {
+        // Coverages are added in fixed blocks of COVERAGE_BLOCK_SIZE contigs, one calculator
+        // per block, and the blocks are merged in order: the sketch (and so the percentiles)
+        // does not depend on the number of threads or on scheduling.
+        const std::vector<float>& covs = contig_collection.covs();
+        size_t num_blocks = (covs.size() + COVERAGE_BLOCK_SIZE - 1) / COVERAGE_BLOCK_SIZE;
+        std::vector<CoverageCalculator> parts(num_blocks);
+        #pragma omp parallel for schedule(static)
+        for (size_t b = 0; b < num_blocks; ++b) {
+            size_t end = std::min(covs.size(), (b + 1) * COVERAGE_BLOCK_SIZE);
+            for (size_t i = b * COVERAGE_BLOCK_SIZE; i < end; ++i) {
+                parts[b].add(covs[i]);
+            }
+        }
+        *this = merge_all(parts);
     }
 
-    float get_min_coverage() const {
-        float min_cov = std::numeric_limits<float>::infinity();
-        for (const auto& cov : _coverages) {
-            min_cov = std::min(min_cov, cov);
+    void add(float cov) {
+        if (std::isnan(cov)) {
+            return;
         }
-        return std::isinf(min_cov) ? std::numeric_limits<float>::quiet_NaN() : min_cov;
+        _min_cov = std::min(_min_cov, cov);
+        _max_cov = std::max(_max_cov, cov);
+        _sum_cov += cov;
+        _num_covs++;
+        _sketch.add(cov);
     }
 
-    float get_max_coverage() const {
-        float max_cov = -std::numeric_limits<float>::infinity();
-        for (const auto& cov : _coverages) {
-            max_cov = std::max(max_cov, cov);
+    void merge(const CoverageCalculator& other) {
+        _min_cov = std::min(_min_cov, other._min_cov);
+        _max_cov = std::max(_max_cov, other._max_cov);
+        _sum_cov += other._sum_cov;
+        _num_covs += other._num_covs;
+        _sketch.merge(other._sketch);
+    }
+
+    static CoverageCalculator merge_all(std::vector<CoverageCalculator>& parts) {
+        // Function merges `parts` pairwise in a tree, the pairs of each round in parallel
+        if (parts.empty()) {
+            return CoverageCalculator();
         }
-        return std::isinf(max_cov) ? std::numeric_limits<float>::quiet_NaN() : max_cov;
+        for (size_t stride = 1; stride < parts.size(); stride *= 2) {
+            #pragma omp parallel for
+            for (size_t t = 0; t < parts.size() - stride; t += 2 * stride) {
+                parts[t].merge(parts[t + stride]);
+            }
+        }
+        return std::move(parts[0]);
+    }
+
+    float get_min_coverage() const {
+        return _num_covs == 0 ? std::numeric_limits<float>::quiet_NaN() : _min_cov;
+    }
+
+    float get_max_coverage() const {
+        return _num_covs == 0 ? std::numeric_limits<float>::quiet_NaN() : _max_cov;
     }
 
     float calc_mean_coverage() const {
-        float sum = 0.0f;
-        for (const auto& cov : _coverages) {
-            sum += cov;
-        }
-        return _coverages.empty() ? std::numeric_limits<float>::quiet_NaN() : sum / _coverages.size();
+        return _num_covs == 0 ? std::numeric_limits<float>::quiet_NaN() : static_cast<float>(_sum_cov / _num_covs);
     }
 
     float calc_median_coverage() const {
-        if (_coverages.empty()) {
+        if (_num_covs == 0) {
             std::cerr << "Error: _coverages is empty, cannot compute median." << std::endl;
             return 0.0f; // или выбросить исключение, если нужно
         }
+        if (_sketch.is_exact()) {
+            // All coverages are still in the sketch (no more than KLL_DEFAULT_K of them in total):
+            // exact median, mean of the middle two for even count. Larger inputs get the
+            // sketch estimate below.
+            std::vector<float> coverages = _sketch.values();
+            size_t size = coverages.size();
+            auto upper = coverages.begin() + size / 2;
+            std::nth_element(coverages.begin(), upper, coverages.end());
+            return size % 2 == 0
+                ? (*std::max_element(coverages.begin(), upper) + *upper) / 2.0f
+                : *upper;
+        }
+        return _sketch.quantile(0.5);
+    }
 
-        std::vector<float> sorted_coverages = _coverages;
-        std::sort(sorted_coverages.begin(), sorted_coverages.end());
-        size_t size = sorted_coverages.size();
+    float calc_percentile_coverage(float percent) const {
+        // Function returns the `percent`-th percentile (0..100) of coverage (NaN if there is none)
+        return _sketch.quantile(percent / 100.0);
+    }
 
-        return size % 2 == 0
-            ? (sorted_coverages[size / 2 - 1] + sorted_coverages[size / 2]) / 2.0f
-            : sorted_coverages[size / 2];
+    uint64_t size() const {
+        return _num_covs;
     }
 
 private:
-    std::vector<float> _coverages;
-
-    std::vector<float> _filter_non_none_covs(const ContigCollection& contig_collection) const {
-        std::vector<float> coverages;
-        for (const auto& contig : contig_collection) {
-            if (contig.cov != std::numeric_limits<float>::quiet_NaN()) {
-                coverages.push_back(contig.cov);
-            }
-        }
-        return coverages;
-    }
+    float _min_cov;
+    float _max_cov;
+    double _sum_cov;
+    uint64_t _num_covs;
+    KllSketch _sketch;
 };
 
-bool is_start_match(const Overlap& ovl) {
-    // Function returns true if overlap `ovl` is associated with start.
-    return (ovl.terminus_i == START && ovl.terminus_j == END) || (ovl.terminus_i == START && ovl.terminus_j == RCSTART);
-}
+/*
+// Function to check if collection is not empty
+int is_not_empty(const std::vector<Overlap>& collection) {
+    return static_cast<int>(collection.size() != 0);
+}*/
 
-bool is_end_match(const Overlap& ovl) {
-    // Function returns true if overlap `ovl` is associated with end.
-    return (ovl.terminus_i == END && ovl.terminus_j == START) || (ovl.terminus_i == END && ovl.terminus_j == RCEND);
-}
+struct _TerminusOverlap {
+    int ovl_len;     // длина перекрытия
+    int order;       // позиция в списке перекрытий контига
+    bool is_counted; // перекрытие учитывается у этого контига
+};
 
-int calc_sum_contig_lengths(const ContigCollection& contig_collection) {
-    int sum_length = 0;
-    for (const Contig& contig : contig_collection) {
-        sum_length += contig.length;
+int64_t _sum_longest_overlaps(std::vector<_TerminusOverlap>& ovls, size_t num_longest) {
+    // Function returns the total length of the counted overlaps among the `num_longest`
+    // longest ones in `ovls` (of equal ones, those listed first); `ovls` is reordered.
+    if (ovls.size() > num_longest) {
+        // Partial selection: only the `num_longest` longest overlaps have to be found, not sorted
+        std::nth_element(ovls.begin(), ovls.begin() + num_longest, ovls.end(),
+                         [](const _TerminusOverlap& a, const _TerminusOverlap& b) {
+                             return a.ovl_len != b.ovl_len ? a.ovl_len > b.ovl_len : a.order < b.order;
+                         });
+        ovls.resize(num_longest);
+    }
+    int64_t total_len = 0;
+    for (const _TerminusOverlap& ovl : ovls) {
+        if (ovl.is_counted) {
+            total_len += ovl.ovl_len;
+        }
     }
-    return sum_length;
+    return total_len;
 }
 
-float calc_lq_coef(const ContigCollection& contig_collection,
-                   const OverlapCollection& overlap_collection) {
-    // Number of termini of a contig
-    int num_contig_termini = 2;
-    // Total number of dead ends taking account of multiplicity
-    float total_dead_ends = 0;
-
-    // Подсчет перекрытий, ассоциированных с началом
-    int start_is_not_dead = 0;
-    // Подсчет перекрытий, ассоциированных с концом
-    int end_is_not_dead = 0;
-
-    for (ContigIndex i = 0; i < contig_collection.size(); ++i) { 
-        for (const auto& overlap : overlap_collection[i]) {
-            if(is_start_match(overlap)){
-                start_is_not_dead = 1;
-            }
-            if(is_end_match(overlap)){
-                end_is_not_dead = 1;
-            }
+int64_t _calc_counted_overlap_len(const OverlapCollection& overlap_collection, ContigIndex i, int multplty,
+                                  std::vector<_TerminusOverlap>& start_ovls,
+                                  std::vector<_TerminusOverlap>& end_ovls) {
+    // Function returns the length of overlapping regions of contig `i` subtracted from the
+    // expected genome size: at each terminus only M longest overlaps are considered,
+    // where M is contig's multiplicity. `start_ovls` and `end_ovls` are scratch buffers.
+    start_ovls.clear();
+    end_ovls.clear();
+
+    int order = 0;
+    for (const Overlap& overlap : overlap_collection[i]) {
+        // Every overlap is counted once: at the contig with the lower index.
+        // An end-to-start self-overlap has a record at both termini, it is counted at the end.
+        bool is_counted = overlap.contig_j > i ||
+            (overlap.contig_j == i && !(overlap.terminus_i == START && overlap.terminus_j == END));
+        if (is_start_match(overlap)) {
+            start_ovls.push_back(_TerminusOverlap{overlap.ovl_len, order, is_counted});
+        } else if (is_end_match(overlap)) {
+            end_ovls.push_back(_TerminusOverlap{overlap.ovl_len, order, is_counted});
         }
-
-        // Calculate number of dead ends of the current contig
-        total_dead_ends += num_contig_termini - start_is_not_dead - end_is_not_dead;
-
-        start_is_not_dead = 0;
-        end_is_not_dead = 0;
+        order++;
     }
-    // Total number of termini taking account of multiplicity
-    int total_termini = num_contig_termini * contig_collection.size();
-    // Calculate the LQ coefficient
-    float lq_coef = (1 - total_dead_ends / total_termini) * 100.0;
 
-    return lq_coef;
+    size_t num_longest = std::max(multplty, 0);
+    return _sum_longest_overlaps(start_ovls, num_longest) + _sum_longest_overlaps(end_ovls, num_longest);
 }
 
-int calc_exp_genome_size(const ContigCollection& contig_collection,
-                         const OverlapCollection& overlap_collection) {
-    // In this variable, total length of overlapping regions will be stored
-    int total_overlap_len = 0;
-
-    std::vector<Contig> contig; 
-
-    // Get start-associated overlaps
-    std::vector<Overlap> start_ovls;
-    // Get end-associated overlaps
-    std::vector<Overlap> end_ovls;
+struct AssemblyStats {
+    // Сводная статистика сборки (см. `calc_assembly_stats`)
+    size_t num_contigs = 0;
+    int64_t total_length = 0;          // сумма длин контигов
+    // Expected length of the genome: total length of contigs taking account of multiplicity
+    // minus total length of overlapping regions (see `_calc_counted_overlap_len`)
+    int64_t expected_genome_size = 0;
+    float min_coverage = std::numeric_limits<float>::quiet_NaN();
+    float max_coverage = std::numeric_limits<float>::quiet_NaN();
+    float mean_coverage = std::numeric_limits<float>::quiet_NaN();
+    float median_coverage = 0.0f;
+    float p5_coverage = std::numeric_limits<float>::quiet_NaN();   // 5-й и 95-й процентили покрытия
+    float p95_coverage = std::numeric_limits<float>::quiet_NaN();
+    size_t num_dead_ends = 0;          // термины без перекрытий
+    float lq_coef = 0.0f;              // доля терминов с перекрытиями, %
+    int n50 = 0;                       // длина N50
+    size_t l50 = 0;                    // число контигов, дающих N50
+    int ng50 = 0;                      // N50 относительно ожидаемой длины генома (0, если недостижимо)
+    size_t lg50 = 0;
+    double aun = 0.0;                  // area under the Nx curve: sum(L^2) / sum(L)
+};
 
-    // Iterate over contigs
-    for (ContigIndex i = 0; i < contig_collection.size(); ++i) {
-        for (const auto& overlap : overlap_collection[i]) {
-            if (is_start_match(overlap)) {
-                start_ovls.push_back(overlap);
-            }
-            if (is_end_match(overlap)) {
-                end_ovls.push_back(overlap);
-            }
+std::pair<int, size_t> _calc_nx(std::vector<int>& lengths, int64_t target) {
+    // Function returns the length Nx and the count Lx: the length of the shortest of the longest
+    // contigs whose total length reaches `target`, and the number of these contigs.
+    // Returns {0, 0} if the total length of all contigs is less than `target`.
+    // Weighted quickselect: expected O(n), without sorting; `lengths` is reordered.
+    if (target <= 0) {
+        return {0, 0};
+    }
+    auto first = lengths.begin();
+    auto last = lengths.end();
+    int64_t sum_before = 0;   // total length of the contigs before `first` (all longer)
+    size_t count_before = 0;
+    while (first != last) {
+        auto mid = first + (last - first) / 2;
+        std::nth_element(first, mid, last, std::greater<int>());
+        int64_t sum_left = 0;
+        for (auto it = first; it != mid; ++it) {
+            sum_left += *it;
         }
+        if (sum_before + sum_left >= target) {
+            last = mid;
+        } else if (sum_before + sum_left + *mid >= target) {
+            return {*mid, count_before + (mid - first) + 1};
+        } else {
+            sum_before += sum_left + *mid;
+            count_before += (mid - first) + 1;
+            first = mid + 1;
+        }
+    }
+    return {0, 0};
+}
 
-        // Function for `filter`.
-        // Purpose: we won't consider contigs with index > i
-        //   in order not to count an overlap twice.
-        auto not_already_counted = [&](const Overlap& x) { return x.contig_j >= i; };
-
-        for (const auto& ovls : {start_ovls, end_ovls}) {
-            std::vector<Overlap> ovls_to_add;
-            if (ovls.size() <= contig_collection[i].multplty) {
-                // No extra overlaps. We will just add lengths of overlaps to `total_overlap_len`.
-                std::copy_if(ovls.begin(), ovls.end(), std::back_inserter(ovls_to_add), not_already_counted);
-            } else {
-                // Some extra overlaps discovered.
-                // We will consider only M longest overlaps, where M is contig's multiplicity.
-                std::vector<Overlap> sorted_ovls = ovls;
-                std::sort(sorted_ovls.begin(), sorted_ovls.end(), [](const Overlap& a, const Overlap& b) {
-                    return a.ovl_len > b.ovl_len;
-                });
-                ovls_to_add.assign(sorted_ovls.begin(), sorted_ovls.begin() + contig_collection[i].multplty);
-                std::copy_if(ovls_to_add.begin(), ovls_to_add.end(), std::back_inserter(ovls_to_add), not_already_counted);
-            }
-
-            // Add lengths of overlaps to `total_overlap_len`
-            for (const auto& ovl : ovls_to_add) {
-                total_overlap_len += ovl.ovl_len;
-            }
+AssemblyStats calc_assembly_stats(const ContigCollection& contig_collection,
+                                  const OverlapCollection& overlap_collection) {
+    // Function computes all statistics of the summary in one parallel pass over contigs
+    // (and their overlaps), with 64-bit accumulators. N50/L50 and NG50/LG50 are then
+    // found by linear-time selection; coverage statistics come from a `CoverageCalculator`
+    // over fixed blocks of contigs, so they do not depend on the number of threads.
+    AssemblyStats stats;
+    stats.num_contigs = contig_collection.size();
+    const int num_contig_termini = 2;
+
+    int64_t total_length = 0;
+    int64_t total_length_multplty = 0;
+    int64_t total_overlap_len = 0;
+    double total_sq_length = 0.0;
+    size_t num_dead_ends = 0;
+
+    #pragma omp parallel
+    {
+        std::vector<_TerminusOverlap> start_ovls;
+        std::vector<_TerminusOverlap> end_ovls;
+
+        #pragma omp for schedule(dynamic, 1024) reduction(+:total_length, total_length_multplty, total_overlap_len, \
+                                                        total_sq_length, num_dead_ends)
+        for (size_t i = 0; i < contig_collection.size(); ++i) {
+            int64_t length = contig_collection.lengths()[i];
+            int multplty = contig_collection.multiplicities()[i];
+            total_length += length;
+            total_length_multplty += length * multplty;
+            total_sq_length += static_cast<double>(length) * length;
+
+            total_overlap_len += _calc_counted_overlap_len(overlap_collection, i, multplty, start_ovls, end_ovls);
+            num_dead_ends += num_contig_termini
+                - (overlap_collection.start_degree(i) > 0) - (overlap_collection.end_degree(i) > 0);
         }
     }
 
-    // Calculate length of the genome, taking account of multiplicity of contigs.
-    int expected_genome_size = 0;
-    for (const auto& contig : contig_collection) {
-        expected_genome_size += contig.length * contig.multplty;
+    stats.total_length = total_length;
+    stats.expected_genome_size = total_length_multplty - total_overlap_len;
+    stats.num_dead_ends = num_dead_ends;
+    if (stats.num_contigs > 0) {
+        stats.lq_coef = (1 - static_cast<float>(num_dead_ends) / (num_contig_termini * stats.num_contigs)) * 100.0;
     }
-    expected_genome_size -= total_overlap_len; // Subtract total length of overlapping regions
 
-    return expected_genome_size;
+    // Coverage statistics
+    CoverageCalculator cov_calc(contig_collection);
+    stats.min_coverage = cov_calc.get_min_coverage();
+    stats.max_coverage = cov_calc.get_max_coverage();
+    stats.mean_coverage = cov_calc.calc_mean_coverage();
+    stats.median_coverage = cov_calc.calc_median_coverage();
+    stats.p5_coverage = cov_calc.calc_percentile_coverage(5);
+    stats.p95_coverage = cov_calc.calc_percentile_coverage(95);
+
+    // Contiguity statistics
+    std::vector<int> lengths(contig_collection.lengths());
+    std::tie(stats.n50, stats.l50) = _calc_nx(lengths, (total_length + 1) / 2);
+    std::tie(stats.ng50, stats.lg50) = _calc_nx(lengths, (stats.expected_genome_size + 1) / 2);
+    stats.aun = total_length > 0 ? total_sq_length / total_length : 0.0;
+
+    return stats;
 }
 
-void write_summary(const ContigCollection& contig_collection, const OverlapCollection& overlap_collection,
-                   const std::string& infpath, const std::string& outdpath) {
+void write_summary(const AssemblyStats& stats, const std::string& infpath, const std::string& outdpath) {
     // Путь к файлу сводки
     std::string summary_fpath = outdpath + "_summary.txt";
     std::cout << "Writing summary to `" << summary_fpath << "`" << std::endl;
@@ -223,252 +343,431 @@ void write_summary(const ContigCollection& contig_collection, const OverlapColle
     // Запись сводки с некоторыми статистическими данными
     outfile << " === Summary ===\n";
 
-    outfile << contig_collection.size() << " contigs were processed.\n";
+    outfile << stats.num_contigs << " contigs were processed.\n";
 
-    outfile << "Sum of contig lengths: " << calc_sum_contig_lengths(contig_collection) << " bp\n";
+    outfile << "Sum of contig lengths: " << stats.total_length << " bp\n";
 
-    outfile << "Expected length of the genome: " << calc_exp_genome_size(contig_collection, overlap_collection) << " bp\n";
-    
-    CoverageCalculator cov_calc(contig_collection);
+    outfile << "Expected length of the genome: " << stats.expected_genome_size << " bp\n";
+
+    outfile << "N50: " << stats.n50 << " bp\n";
+    outfile << "L50: " << stats.l50 << "\n";
+    outfile << "NG50: " << stats.ng50 << " bp\n";
+    outfile << "LG50: " << stats.lg50 << "\n";
+    outfile << "auN: " << stats.aun << " bp\n";
 
     // Min coverage
-    float min_coverage = cov_calc.get_min_coverage();
-    outfile << "Min coverage: " << std::to_string(min_coverage) << "\n";
+    outfile << "Min coverage: " << std::to_string(stats.min_coverage) << "\n";
 
     // Max coverage
-    float max_coverage = cov_calc.get_max_coverage();
-    outfile << "Max coverage: " << std::to_string(max_coverage) << "\n";
+    outfile << "Max coverage: " << std::to_string(stats.max_coverage) << "\n";
 
     // Mean coverage
-    float mean_coverage = cov_calc.calc_mean_coverage();
-    outfile << "Mean coverage: " << std::to_string(mean_coverage) << "\n";
-    
+    outfile << "Mean coverage: " << std::to_string(stats.mean_coverage) << "\n";
+
     // Median coverage
-    float median_coverage = cov_calc.calc_median_coverage();
-    outfile << "Median coverage: " << std::to_string(median_coverage) << "\n";
-    
-    outfile << "LQ-coefficient: " << calc_lq_coef(contig_collection, overlap_collection) << "\n";
-}
+    outfile << "Median coverage: " << std::to_string(stats.median_coverage) << "\n";
 
-std::vector<Overlap> _get_start_matches(const std::vector<Overlap>& overlaps) {
-    std::vector<Overlap> start_matches;
-    for (const auto& overlap : overlaps) {
-        if (is_start_match(overlap)) {
-            start_matches.push_back(overlap);
-        }
-    }
-    return start_matches;
-}
+    // 5th and 95th percentiles of coverage
+    outfile << "P5 coverage: " << std::to_string(stats.p5_coverage) << "\n";
+    outfile << "P95 coverage: " << std::to_string(stats.p95_coverage) << "\n";
 
-std::vector<Overlap> _get_end_matches(const std::vector<Overlap>& overlaps) {
-    std::vector<Overlap> end_matches;
-    for (const auto& overlap : overlaps) {
-        if (is_end_match(overlap)) {
-            end_matches.push_back(overlap);
-        }
-    }
-    return end_matches;
+    outfile << "LQ-coefficient: " << stats.lq_coef << "\n";
 }
 
-std::function<std::vector<Overlap>(const std::vector<Overlap>&)> _select_get_matches(const std::string& term) {
+OverlapPredicate _select_get_matches(const std::string& term) {
     if (term == "s") {
-        return _get_start_matches;
+        return is_start_match;
     } else if (term == "e") {
-        return _get_end_matches;
+        return is_end_match;
     } else {
-        std::cerr << "Fatal error: invalid value passed to function `_get_overlaps_str_for_table` with argument `term`: `" << term << "`" << std::endl;
+        std::cerr << "Fatal error: invalid value passed to function `_write_overlaps_for_table` with argument `term`: `" << term << "`" << std::endl;
         std::cerr << "Please, contact the developer." << std::endl;
         exit(1);
     }
 }
 
-std::string _get_overlaps_str_for_table(const OverlapCollection& overlap_collection,
-                                        const ContigCollection& contig_collection,
-                                        ContigIndex key, const std::string& term) {
-    // Select function for obtaining `term`-associated overlaps.
-    auto get_matches = _select_get_matches(term);
 
-    // Extract overlaps associated with `term` terminus for `key` contig
-    auto overlaps = get_matches(overlap_collection[key]);
+void _write_overlaps_for_table(OutputBuffer& out, const OverlapCollection& overlap_collection,
+                               const ContigCollection& contig_collection,
+                               ContigIndex key, const std::string& term) {
+    // Function writes the "Start" or "End" cell of contig `key`: its `term`-associated overlaps
+    // separated with spaces, or "-" if there are none.
+    // Select predicate for `term`-associated overlaps.
+    OverlapPredicate is_match = _select_get_matches(term);
 
-    // Convert `Overlap` instances to string representation
-    if (overlaps.empty()) {
-        return "-"; // no proper overlaps found
-    } else {
-        std::vector<std::string> match_strings; // vector for formatted strings
-
-        for (const auto& ovl : overlaps) {
-            // If contig does not match itself
-            if (ovl.contig_i != ovl.contig_j) {
-                // Letter for the first contig of the overlap
-                std::string letter1(1, KEY2LETTER_MAP.at(ovl.terminus_i)[0]);
-                std::string letter2(1, KEY2LETTER_MAP.at(ovl.terminus_j)[0]);
-
-                // Convert and append
-                match_strings.push_back("[" + letter1 + "=" + letter2 + "(" + contig_collection[ovl.contig_j].name + "); ovl=" + std::to_string(ovl.ovl_len) + "]");
-            } else {
-                match_strings.push_back("[Circle; ovl=" + std::to_string(ovl.ovl_len) + "]");
-            }
+    // View of overlaps associated with `term` terminus for `key` contig
+    FilteredOverlapView overlaps = overlap_collection.filter(key, is_match);
+
+    bool is_first = true;
+    for (const Overlap& ovl : overlaps) {
+        if (!is_first) {
+            out.write(' ');
         }
+        is_first = false;
+
+        // If contig does not match itself
+        if (ovl.contig_i != ovl.contig_j) {
+            // Letters for the termini of the overlap
+            out.write('[');
+            out.write(TERMINUS_LETTERS[ovl.terminus_i][0]);
+            out.write('=');
+            out.write(TERMINUS_LETTERS[ovl.terminus_j][0]);
+            out.write('(');
+            out.write(contig_collection.names()[ovl.contig_j]);
+            out.write("); ovl=");
+        } else {
+            out.write("[Circle; ovl=");
+        }
+        out.write_int(ovl.ovl_len);
+        out.write(']');
+    }
 
-        // Separate formatted strings with spaces
-        return std::accumulate(std::next(match_strings.begin()), match_strings.end(),
-                               match_strings.front(),
-                               [](const std::string& a, const std::string& b) {
-                                   return a + " " + b;
-                               });
+    if (is_first) {
+        out.write('-'); // no proper overlaps found
     }
 }
 
-std::string _get_overlaps_str_for_log(const OverlapCollection& overlap_collection,
-                                      const ContigCollection& contig_collection,
-                                      ContigIndex key) {
-    // Extract overlaps for the current contig
-    const std::vector<Overlap>& overlaps = overlap_collection[key];
+bool _write_overlaps_for_log(OutputBuffer& out, const OverlapCollection& overlap_collection,
+                             const ContigCollection& contig_collection,
+                             ContigIndex key) {
+    // Function writes the full log lines of contig `key`; returns false if there were none.
+    const std::string& name = contig_collection.names()[key];
+    bool is_written = false;
+
+    for (const Overlap& ovl : overlap_collection[key]) {
+        // If contig does not match itself
+        if (ovl.contig_i != ovl.contig_j) {
+            out.write(name);
+            out.write(": ");
+            out.write(TERMINUS_WORDS[ovl.terminus_i]);
+            out.write(" matches ");
+            out.write(TERMINUS_WORDS[ovl.terminus_j]);
+            out.write(" of ");
+            out.write(contig_collection.names()[ovl.contig_j]);
+            out.write(" with overlap of ");
+        }
+        // Contig is circular
+        else if (ovl.terminus_i == END && ovl.terminus_j == START) {
+            out.write(name);
+            out.write(": contig is circular with overlap of ");
+        }
+        // Start of contig matches its own reverse-complement end
+        else if (ovl.terminus_i == START && ovl.terminus_j == RCEND) {
+            out.write(name);
+            out.write(": start is identical to its own rc-end with overlap of ");
+        } else {
+            continue;
+        }
+        out.write_int(ovl.ovl_len);
+        out.write(" bp\n");
+        is_written = true;
+    }
+
+    return is_written;
+}
 
-    if (overlaps.empty()) {
-        return ""; // no proper overlaps found
-    } else {
-        std::string result; // string for formatted strings
-
-        for (const Overlap& ovl : overlaps) {
-            // If contig does not match itself
-            if (ovl.contig_i != ovl.contig_j) {
-                // Word for the first contig of the overlap
-                std::string word1 = KEY2WORD_MAP.at(ovl.terminus_i);
-                // Word for the second contig of the overlap
-                std::string word2 = KEY2WORD_MAP.at(ovl.terminus_j);
-
-                // Convert and append
-                result += contig_collection[key].name + ": " +
-                          word1 + " matches " + word2 +
-                          " of " + contig_collection[ovl.contig_j].name +
-                          " with overlap of " + std::to_string(ovl.ovl_len) + " bp\n";
-            } else {
-                // Contig is circular
-                if (ovl.terminus_i == END && ovl.terminus_j == START) {
-                    result += contig_collection[key].name +
-                              ": contig is circular with overlap of " +
-                              std::to_string(ovl.ovl_len) + " bp\n";
-                }
-                // Start of contig matches its own reverse-complement end
-                else if (ovl.terminus_i == START && ovl.terminus_j == RCEND) {
-                    result += contig_collection[key].name +
-                              ": start is identical to its own rc-end with overlap of " +
-                              std::to_string(ovl.ovl_len) + " bp\n";
-                }
+const size_t OUTPUT_CHUNK_ROWS = 1024;
+
+template <typename FormatRows>
+void _write_rows_in_order(size_t num_rows, const std::vector<std::ostream*>& outs, FormatRows format_rows) {
+    // Function formats rows [0, num_rows) in chunks on worker threads: each chunk is written by
+    // `format_rows(begin, end, buffers)` into one in-memory buffer per output stream in `outs`.
+    // The buffers of a chunk are committed to the streams in row order, so the files are the
+    // same as if the rows were written one after another.
+    size_t num_chunks = (num_rows + OUTPUT_CHUNK_ROWS - 1) / OUTPUT_CHUNK_ROWS;
+
+    #pragma omp parallel
+    {
+        // Буферы потока, переиспользуемые между блоками
+        std::vector<OutputBuffer> buffers(outs.size());
+
+        #pragma omp for ordered schedule(dynamic, 1)
+        for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+            size_t begin = chunk * OUTPUT_CHUNK_ROWS;
+            format_rows(begin, std::min(num_rows, begin + OUTPUT_CHUNK_ROWS), buffers);
+
+            #pragma omp ordered
+            for (size_t o = 0; o < outs.size(); ++o) {
+                buffers[o].write_to(*outs[o]);
             }
         }
-
-        return result;
     }
 }
 
-void write_adjacency_table_and_full_log(const ContigCollection& contig_collection,
-                           const OverlapCollection& overlap_collection,
-                           const std::string& outdpath) {
-    // Сформировать путь к выходному файлу TSV
-    std::string adj_table_fpath = outdpath + "__adjacent_contigs.tsv";
+void _write_table_header(std::ostream& out) {
+    out << "#\tContig name\tLength\tCoverage\tGC(%)\tMultiplicity\tAnnotation\tStart\tEnd\n";
+}
 
-    // Сформировать путь к файлу полного журнала
-    std::string log_fpath = outdpath + "_full_matching_log.txt";
+void _write_table_row(OutputBuffer& table, const ContigCollection& contig_collection,
+                      const OverlapCollection& overlap_collection, ContigIndex i) {
+    ConstContigRef contig = contig_collection[i];
 
-    std::cout << "Writing adjacency table to `" << adj_table_fpath << "`"<< std::endl << "Writing full matching log to `" << log_fpath << "`"  << std::endl;
+    // Порядковый номер и имя
+    table.write_int(i + 1);
+    table.write('\t');
+    table.write(contig.name);
+    table.write('\t');
 
-    // Открыть выходной файл для записи
-    std::ofstream outfile_table(adj_table_fpath);
-    std::ofstream outfile_log(log_fpath);
-    if (!outfile_table.is_open() || !outfile_log.is_open()) {
-        std::cerr << "Error: Unable to open output file" << std::endl;
-        return;
+    // Длина
+    table.write_int(contig.length);
+    table.write('\t');
+
+    // Покрытие
+    if (contig.cov == -1) {
+        table.write('-');
+    } else {
+        table.write_fixed(contig.cov, 6);
     }
+    table.write('\t');
 
-    // Записать заголовок таблицы
-    outfile_table << "#\tContig name\tLength\tCoverage\tGC(%)\tMultiplicity\tAnnotation\tStart\tEnd\n";
+    // Содержание GC в контиге
+    table.write_general(contig.gc_content);
+    table.write('\t');
 
-    std::string wrk_str;
+    // Множество копий
+    table.write_int(contig.multplty);
+    table.write('\t');
 
-    // Пройти по контигам и записать их свойства
-    for (ContigIndex i = 0; i < contig_collection.size(); ++i) {
-        const Contig& contig = contig_collection[i];
+    // Пустая колонка для аннотации
+    table.write('\t');
 
-        // Порядковый номер и имя
-        outfile_table << i + 1 << "\t" << contig.name << "\t";
+    // Информация о найденных смежностях
+    // Колонка "Start"
+    _write_overlaps_for_table(table, overlap_collection, contig_collection, i, "s");
+    table.write('\t');
 
-        // Длина
-        outfile_table << contig.length << "\t";
+    // Колонка "End"
+    _write_overlaps_for_table(table, overlap_collection, contig_collection, i, "e");
+    table.write('\n');
+}
 
-        // Покрытие
-        wrk_str = (contig.cov == -1) ? "-" : std::to_string(contig.cov);
-        outfile_table << wrk_str << "\t";
+void _write_log_record(OutputBuffer& log, const ContigCollection& contig_collection,
+                       const OverlapCollection& overlap_collection, ContigIndex i) {
+    // Записать совпадения текущего контига, отделив их пустой строкой
+    if (_write_overlaps_for_log(log, overlap_collection, contig_collection, i)) {
+        log.write('\n');
+    }
+}
 
-        // Содержание GC в контиге
-        outfile_table << contig.gc_content << "\t";
+void _write_genbank_header(std::ostream& out) {
+    // Записать заголовок файла GenBank
+    out << "LOCUS       ___Exported_from_AssemblyTool\n";
+    out << "DEFINITION  ___Genomic sequence data.\n";
+    out << "ACCESSION   ___N/A\n";
+    out << "VERSION     ___N/A\n";
+    out << "KEYWORDS    ___.\n";
+    out << "SOURCE      ___Synthetic construct\n";
+    out << "  ORGANISM  ___Synthetic construct\n";
+    out << "            ___Unclassified.\n";
+    out << "FEATURES             ___Location/Qualifiers\n";
+}
 
-        // Множество копий
-        outfile_table << contig.multplty << "\t";
+void _write_genbank_record(OutputBuffer& out, const ContigCollection& contig_collection,
+                           const OverlapCollection& overlap_collection, ContigIndex i) {
+    ConstContigRef contig = contig_collection[i];
+    out.write("     contig          ");
+    out.write(contig.name);
+    out.write("\n                     /note=\"length: ");
+    out.write_int(contig.length);
+    out.write(" bp\"\n                     /note=\"coverage: ");
+    if (contig.cov == -1) {
+        out.write("N/A");
+    } else {
+        out.write_fixed(contig.cov, 6);
+    }
+    out.write("\"\n                     /note=\"GC content: ");
+    out.write_fixed(contig.gc_content, 2);
+    out.write("%\"\n                     /note=\"multiplicity: ");
+    out.write_int(contig.multplty);
+    out.write("\"\n");
+
+    // Добавить аннотации, если они есть
+    /*if (!contig.annotation.empty()) {
+        outfile << "                     /note=\"" << contig.annotation << "\"\n";
+    }*/
+
+    // Если необходимо, можно добавить информацию о перекрытиях
+    for (const Overlap& ovl : overlap_collection[i]) {
+        out.write("     overlap         ");
+        out.write_int(ovl.ovl_len);
+        out.write(" bp\n                     /note=\"with contig ");
+        out.write(contig_collection.names()[ovl.contig_j]);
+        out.write("\"\n");
+    }
+}
 
-        // Пустая колонка для аннотации
-        outfile_table << "\t";
+std::string_view _gfa_segment_name(std::string_view name) {
+    // GFA names carry no FASTA '>' and no whitespace: the header is cut at its first space,
+    // as FASTA tools do with sequence IDs
+    if (!name.empty() && name[0] == '>') {
+        name.remove_prefix(1);
+    }
+    return name.substr(0, name.find_first_of(" \t"));
+}
 
-        // Информация о найденных смежностях
-        // Колонка "Start"
-        wrk_str = _get_overlaps_str_for_table(overlap_collection, contig_collection, i, "s");
-        outfile_table << wrk_str << "\t";
+class GfaSegmentNames {
+    // Names of the GFA segments of contigs.
+    // Contigs whose headers share the part before the first space are renamed once, before writing:
+    // to the whole header with whitespace replaced by '_', or, if that is not unique either,
+    // to the short name with the contig number appended. Other contigs keep the short name.
+public:
+    explicit GfaSegmentNames(const ContigCollection& contig_collection) : _contig_collection(contig_collection) {
+        const std::vector<std::string>& names = contig_collection.names();
+        std::unordered_map<std::string_view, size_t> counts;
+        counts.reserve(names.size());
+        for (const std::string& name : names) {
+            ++counts[_gfa_segment_name(name)];
+        }
+        if (counts.size() == names.size()) {
+            return;
+        }
 
-        // Колонка "End"
-        wrk_str = _get_overlaps_str_for_table(overlap_collection, contig_collection, i, "e");
-        outfile_table << wrk_str << "\n";
+        std::unordered_set<std::string> taken;
+        auto is_free = [&](const std::string& candidate) {
+            return counts.find(candidate) == counts.end() && taken.find(candidate) == taken.end();
+        };
+        for (ContigIndex i = 0; i < names.size(); ++i) {
+            std::string_view short_name = _gfa_segment_name(names[i]);
+            if (counts[short_name] == 1) {
+                continue;
+            }
+            std::string name = _sanitized_header(names[i]);
+            if (!is_free(name)) {
+                name = std::string(short_name) + "_" + std::to_string(i + 1);
+                while (!is_free(name)) {
+                    name += "_" + std::to_string(i + 1);
+                }
+            }
+            taken.insert(name);
+            _renamed.emplace(i, std::move(name));
+        }
+        std::cerr << "Warning: " << _renamed.size() << " contigs share GFA segment names "
+                  << "(headers up to the first space) and were renamed in the overlap graph" << std::endl;
+    }
+
+    std::string_view operator[](ContigIndex i) const {
+        auto it = _renamed.find(i);
+        if (it != _renamed.end()) {
+            return it->second;
+        }
+        return _gfa_segment_name(_contig_collection.names()[i]);
+    }
+
+private:
+    static std::string _sanitized_header(std::string_view name) {
+        if (!name.empty() && name[0] == '>') {
+            name.remove_prefix(1);
+        }
+        std::string result(name);
+        std::replace_if(result.begin(), result.end(), [](char c) { return c == ' ' || c == '\t'; }, '_');
+        return result;
+    }
+
+    const ContigCollection& _contig_collection;
+    std::unordered_map<ContigIndex, std::string> _renamed;
+};
+
+void _write_gfa_header(std::ostream& out) {
+    out << "H\tVN:Z:1.0\n";
+}
 
-        // Записать совпадения, с которыми связан начало текущего контига
-        wrk_str = _get_overlaps_str_for_log(overlap_collection, contig_collection, i);
-        if (!wrk_str.empty()) {
-            outfile_log << wrk_str << "\n";
+void _write_gfa_link(OutputBuffer& out, const GfaSegmentNames& segment_names,
+                     ContigIndex from, char from_orient, ContigIndex to, char to_orient, int ovl_len) {
+    out.write("L\t");
+    out.write(segment_names[from]);
+    out.write('\t');
+    out.write(from_orient);
+    out.write('\t');
+    out.write(segment_names[to]);
+    out.write('\t');
+    out.write(to_orient);
+    out.write('\t');
+    out.write_int(ovl_len);
+    out.write("M\n");
+}
+
+void _write_gfa_record(OutputBuffer& out, const ContigCollection& contig_collection,
+                       const OverlapCollection& overlap_collection, const GfaSegmentNames& segment_names,
+                       ContigIndex i) {
+    // Function writes the segment of contig i and the links of its overlaps.
+    // Sequences are not kept, so the segment is `*` with its length, coverage (if known)
+    // and GC content in tags.
+    ConstContigRef contig = contig_collection[i];
+    out.write("S\t");
+    out.write(segment_names[i]);
+    out.write("\t*\tLN:i:");
+    out.write_int(contig.length);
+    if (contig.cov != -1) {
+        out.write("\tdp:f:");
+        out.write_fixed(contig.cov, 6);
+    }
+    out.write("\tgc:f:");
+    out.write_general(contig.gc_content);
+    out.write('\n');
+
+    // Each overlap is listed by both of its contigs; its link is written once:
+    // i+ -> j+ from the record with the end of i, the others from the lower-indexed contig.
+    // Shared prefixes and suffixes (START-START, END-END and the like) are not
+    // dovetail overlaps and have no GFA link.
+    for (const Overlap& ovl : overlap_collection[i]) {
+        if (ovl.terminus_i == END && ovl.terminus_j == START) {
+            // End of i matches start of j
+            _write_gfa_link(out, segment_names, i, '+', ovl.contig_j, '+', ovl.ovl_len);
+        } else if (ovl.terminus_i == END && ovl.terminus_j == RCEND && i <= ovl.contig_j) {
+            // End of i matches rc-end of j
+            _write_gfa_link(out, segment_names, i, '+', ovl.contig_j, '-', ovl.ovl_len);
+        } else if (ovl.terminus_i == START && ovl.terminus_j == RCSTART && i <= ovl.contig_j) {
+            // Rc-start of j matches start of i: j- -> i+, the same link as i- -> j+
+            _write_gfa_link(out, segment_names, i, '-', ovl.contig_j, '+', ovl.ovl_len);
         }
     }
 }
 
-void write_genbank(const ContigCollection& contig_collection, const OverlapCollection& overlap_collection, const std::string& outdpath) {
-    // Сформировать путь к выходному файлу GenBank
+void write_outputs(const ContigCollection& contig_collection, const OverlapCollection& overlap_collection,
+                   const AssemblyStats& stats, const std::string& infpath, const std::string& outdpath) {
+    // Function writes the summary, the adjacency table, the full log, the GenBank file,
+    // the GFA overlap graph and the columnar tables for R.
+    // The rows of the text outputs are formatted together, in one parallel pass over contigs;
+    // each format is defined only by its `_write_*_header` and `_write_*_row/record` functions.
+    write_summary(stats, infpath, outdpath);
+    write_columnar_tables(contig_collection, overlap_collection, outdpath);
+
+    std::string adj_table_fpath = outdpath + "__adjacent_contigs.tsv";
+    std::string log_fpath = outdpath + "_full_matching_log.txt";
     std::string genbank_fpath = outdpath + "_annotated_genbank.gtf";
-    std::cout << "Writing GenBank file to `" << genbank_fpath << "`" << std::endl;
+    std::string gfa_fpath = outdpath + "_overlap_graph.gfa";
+    std::cout << "Writing adjacency table to `" << adj_table_fpath << "`" << std::endl
+              << "Writing full matching log to `" << log_fpath << "`" << std::endl
+              << "Writing GenBank file to `" << genbank_fpath << "`" << std::endl
+              << "Writing overlap graph to `" << gfa_fpath << "`" << std::endl;
 
-    // Открыть выходной файл для записи
-    std::ofstream outfile(genbank_fpath);
-    if (!outfile.is_open()) {
-        std::cerr << "Error: Unable to open file for writing: " << genbank_fpath << std::endl;
+    std::ofstream outfile_table(adj_table_fpath);
+    std::ofstream outfile_log(log_fpath);
+    std::ofstream outfile_genbank(genbank_fpath);
+    std::ofstream outfile_gfa(gfa_fpath);
+    if (!outfile_table.is_open() || !outfile_log.is_open() || !outfile_genbank.is_open() || !outfile_gfa.is_open()) {
+        std::cerr << "Error: Unable to open output file" << std::endl;
         return;
     }
 
-    // Записать заголовок файла GenBank
-    outfile << "LOCUS       ___Exported_from_AssemblyTool\n";
-    outfile << "DEFINITION  ___Genomic sequence data.\n";
-    outfile << "ACCESSION   ___N/A\n";
-    outfile << "VERSION     ___N/A\n";
-    outfile << "KEYWORDS    ___.\n";
-    outfile << "SOURCE      ___Synthetic construct\n";
-    outfile << "  ORGANISM  ___Synthetic construct\n";
-    outfile << "            ___Unclassified.\n";
-    outfile << "FEATURES             ___Location/Qualifiers\n";
-
-    // Записать информацию о контигах
-    for (ContigIndex i = 0; i < contig_collection.size(); ++i) {
-        outfile << "     contig          " << contig_collection[i].name << "\n";
-        outfile << "                     /note=\"length: " << contig_collection[i].length << " bp\"\n";
-        outfile << "                     /note=\"coverage: " << (contig_collection[i].cov == -1 ? "N/A" : std::to_string(contig_collection[i].cov)) << "\"\n";
-        outfile << "                     /note=\"GC content: " << std::fixed << std::setprecision(2) << contig_collection[i].gc_content << "%\"\n";
-        outfile << "                     /note=\"multiplicity: " << contig_collection[i].multplty << "\"\n";
-        
-        // Extract overlaps for the current contig
-        const std::vector<Overlap>& overlaps = overlap_collection[i];
-
-        // Если необходимо, можно добавить информацию о перекрытиях
-        for (const Overlap& ovl : overlaps) {
-            outfile << "     overlap         " << ovl.ovl_len << " bp\n";
-            outfile << "                     /note=\"with contig " << contig_collection[ovl.contig_j].name << "\"\n";
-        }
-    }
+    _write_table_header(outfile_table);
+    _write_genbank_header(outfile_genbank);
+    _write_gfa_header(outfile_gfa);
+    GfaSegmentNames segment_names(contig_collection);
+
+    _write_rows_in_order(contig_collection.size(), {&outfile_table, &outfile_log, &outfile_genbank, &outfile_gfa},
+        [&](size_t begin, size_t end, std::vector<OutputBuffer>& buffers) {
+            for (size_t i = begin; i < end; ++i) {
+                _write_table_row(buffers[0], contig_collection, overlap_collection, i);
+                _write_log_record(buffers[1], contig_collection, overlap_collection, i);
+                _write_genbank_record(buffers[2], contig_collection, overlap_collection, i);
+                _write_gfa_record(buffers[3], contig_collection, overlap_collection, segment_names, i);
+            }
+        });
+}
 
-    // Закрыть файл
-    outfile.close();
-} 
\ No newline at end of file
+void write_outputs(const ContigCollection& contig_collection, const OverlapCollection& overlap_collection,
+                   const std::string& infpath, const std::string& outdpath) {
+    write_outputs(contig_collection, overlap_collection,
+                  calc_assembly_stats(contig_collection, overlap_collection), infpath, outdpath);
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ostream>
+#include <charconv>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+// Buffered formatter for the output writers: fields are formatted straight into one
+// reusable byte buffer (numbers with `std::to_chars`) and written to the stream in
+// large blocks, without temporary strings.
+// Floating-point fields are formatted as the streams format them, so output is byte-identical:
+// `write_general` as `stream << value` (%g, 6 digits), `write_fixed` as `std::fixed` with
+// `std::setprecision`, and `write_fixed(value, 6)` as `std::to_string`.
+// Without a stream the buffer grows instead and is written out with `write_to`
+// (e.g. rows formatted on worker threads and committed in order).
+
+const size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+const size_t OUTPUT_CHUNK_BUFFER_SIZE = 1 << 16;
+
+class OutputBuffer {
+public:
+    // Конструктор класса OutputBuffer: буфер размером `capacity` байт для потока `out`
+    explicit OutputBuffer(std::ostream& out, size_t capacity = OUTPUT_BUFFER_SIZE) :
+        _out(&out), _buffer(capacity), _size(0) {}
+
+    // Буфер в памяти (без потока), растущий по мере записи
+    explicit OutputBuffer(size_t capacity = OUTPUT_CHUNK_BUFFER_SIZE) :
+        _out(nullptr), _buffer(capacity), _size(0) {}
+
+    // Копирование запрещено: у буфера один поток
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    ~OutputBuffer() {
+        flush();
+    }
+
+    void write(std::string_view str) {
+        if (_out != nullptr && str.size() > _buffer.size()) {
+            flush();
+            _out->write(str.data(), str.size());
+            return;
+        }
+        _reserve(str.size());
+        std::memcpy(_buffer.data() + _size, str.data(), str.size());
+        _size += str.size();
+    }
+
+    void write(char c) {
+        _reserve(1);
+        _buffer[_size++] = c;
+    }
+
+    void write_int(int64_t value) {
+        _reserve(MAX_NUMBER_LEN);
+        char* begin = _buffer.data() + _size;
+        _size = std::to_chars(begin, begin + MAX_NUMBER_LEN, value).ptr - _buffer.data();
+    }
+
+    void write_general(double value) {
+        // As `stream << value` with the default precision
+#ifdef __cpp_lib_to_chars
+        _reserve(MAX_NUMBER_LEN);
+        char* begin = _buffer.data() + _size;
+        _size = std::to_chars(begin, begin + MAX_NUMBER_LEN, value, std::chars_format::general, 6).ptr - _buffer.data();
+#else
+        _write_printf("%.6g", value);
+#endif
+    }
+
+    void write_fixed(double value, int precision) {
+        // As `stream << std::fixed << std::setprecision(precision) << value`.
+        // Large values have many digits in fixed notation, so those go through a string
+        // (which is rare: coverage, GC content and the like are small).
+#ifdef __cpp_lib_to_chars
+        _reserve(MAX_NUMBER_LEN);
+        char* begin = _buffer.data() + _size;
+        std::to_chars_result result = std::to_chars(begin, begin + MAX_NUMBER_LEN, value,
+                                                    std::chars_format::fixed, precision);
+        if (result.ec == std::errc()) {
+            _size = result.ptr - _buffer.data();
+            return;
+        }
+#endif
+        std::vector<char> str(std::snprintf(nullptr, 0, "%.*f", precision, value) + 1);
+        std::snprintf(str.data(), str.size(), "%.*f", precision, value);
+        write(std::string_view(str.data(), str.size() - 1));
+    }
+
+    void flush() {
+        if (_out != nullptr && _size > 0) {
+            _out->write(_buffer.data(), _size);
+            _size = 0;
+        }
+    }
+
+    // Write the contents to `out` and empty the buffer
+    void write_to(std::ostream& out) {
+        out.write(_buffer.data(), _size);
+        _size = 0;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    static const size_t MAX_NUMBER_LEN = 64;
+
+    std::ostream* _out;  // nullptr: the buffer grows instead of being flushed
+    std::vector<char> _buffer;
+    size_t _size;
+
+    void _reserve(size_t len) {
+        if (_size + len <= _buffer.size()) {
+            return;
+        }
+        flush();
+        if (_size + len > _buffer.size()) {
+            _buffer.resize(std::max(2 * _buffer.size(), _size + len));
+        }
+    }
+
+#ifndef __cpp_lib_to_chars
+    void _write_printf(const char* format, double value) {
+        _reserve(MAX_NUMBER_LEN);
+        _size += std::snprintf(_buffer.data() + _size, MAX_NUMBER_LEN, format, value);
+    }
+#endif
+};
@@ -5,8 +5,17 @@
 #include <vector>
 #include <unordered_map> 
 #include <array>
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <cassert>
 
 #include "contigs.hpp"
+#include "packed_termini.hpp"
 
 using namespace std;
 
@@ -26,6 +35,8 @@ public:
             contig_j(contig_j), terminus_j(terminus_j),
             ovl_len(ovl_len) {}
 
+    Overlap() : Overlap(0, START, 0, START, 0) {}
+
     // Поля класса
     ContigIndex contig_i; // индекс (ключ) первого контига
     Terminus terminus_i; // термин (первого контига) участвующий в перекрытии
@@ -34,7 +45,7 @@ public:
     int ovl_len; // длина перекрытия
 
     // Переопределение оператора преобразования в строку (аналог __repr__ в Python)
-    std::string to_string() const {
+    std::string to_string() const {                                                 /////////Не используется (для тестов)
         return "<" + std::to_string(contig_i) + "-" + std::to_string(terminus_i) +
                "; " + std::to_string(contig_j) + "-" + std::to_string(terminus_j) +
                "; len=" + std::to_string(ovl_len) + ">";
@@ -67,38 +78,481 @@ private:
     }
 };
 
+// Terminus pairs of the two `Overlap` records of each of the eight
+// orientation cases checked between contigs i and j (see `detect_adjacent_contigs`):
+// {terminus of i, terminus of j} for the record keyed by i,
+// {terminus of j, terminus of i} for the mirrored record keyed by j.
+const Terminus PAIR_CASE_TERMINI[8][4] = {
+    {START, END,     END,     START},  // end of j matches start of i
+    {END,   START,   START,   END},    // end of i matches start of j
+    {START, RCSTART, START,   RCSTART},// rc-start of j matches start of i
+    {END,   RCEND,   END,     RCEND},  // end of i matches rc-end of j
+    {START, START,   START,   START},  // starts share a prefix
+    {END,   END,     END,     END},    // ends share a suffix
+    {START, RCEND,   RCEND,   START},  // start of i shares a prefix with rc-end of j
+    {END,   RCSTART, RCSTART, END}     // end of i shares a suffix with rc-start of j
+};
+
+// The same for the two self-overlap cases of a contig: end matches its own start (e2s),
+// start shares a prefix with its own rc-end (s2s)
+const Terminus SELF_CASE_TERMINI[2][4] = {
+    {END,   START,   START,   END},
+    {START, RCEND,   RCEND,   START}
+};
+
+int _overlap_rank(const Overlap& ovl) {
+    // Function returns the position of `ovl` among the records of the same contig pair,
+    // in the order the all-pairs search emits them (see `PAIR_CASE_TERMINI`).
+    // Terminus pairs the search never emits (e.g. from assembly graphs) go last.
+    const Terminus (*termini)[4] = ovl.contig_j == ovl.contig_i ? SELF_CASE_TERMINI : PAIR_CASE_TERMINI;
+    int num_cases = ovl.contig_j == ovl.contig_i ? 2 : 8;
+    for (int c = 0; c < num_cases; ++c) {
+        if (ovl.contig_j > ovl.contig_i && termini[c][0] == ovl.terminus_i && termini[c][1] == ovl.terminus_j) {
+            return c;
+        }
+        if (ovl.contig_j < ovl.contig_i && termini[c][2] == ovl.terminus_i && termini[c][3] == ovl.terminus_j) {
+            return c;
+        }
+        if (ovl.contig_j == ovl.contig_i) {
+            if (termini[c][0] == ovl.terminus_i && termini[c][1] == ovl.terminus_j) return 2 * c;
+            if (termini[c][2] == ovl.terminus_i && termini[c][3] == ovl.terminus_j) return 2 * c + 1;
+        }
+    }
+    return 8 + 4 * ovl.terminus_i + ovl.terminus_j;
+}
+
+bool _overlap_order(const Overlap& a, const Overlap& b) {
+    // Order of the records of one contig: by the other contig, then by orientation case
+    if (a.contig_j != b.contig_j) return a.contig_j < b.contig_j;
+    return _overlap_rank(a) < _overlap_rank(b);
+}
+
+void _exclusive_scan(const std::vector<size_t>& counts, std::vector<size_t>& offsets) {
+    // Function writes prefix sums of `counts` to `offsets` (of size counts.size() + 1):
+    // block sums are computed in parallel, scanned, and then added back block by block.
+    size_t n = counts.size();
+    int num_blocks = 1;
+#ifdef _OPENMP
+    num_blocks = omp_get_max_threads();
+#endif
+    size_t block_size = (n + num_blocks - 1) / num_blocks;
+    std::vector<size_t> block_offsets(num_blocks + 1, 0);
+
+    #pragma omp parallel for
+    for (int b = 0; b < num_blocks; ++b) {
+        size_t sum = 0;
+        for (size_t i = b * block_size; i < std::min(n, (b + 1) * block_size); ++i) {
+            sum += counts[i];
+        }
+        block_offsets[b + 1] = sum;
+    }
+    for (int b = 0; b < num_blocks; ++b) {
+        block_offsets[b + 1] += block_offsets[b];
+    }
+
+    offsets.assign(n + 1, 0);
+    #pragma omp parallel for
+    for (int b = 0; b < num_blocks; ++b) {
+        size_t sum = block_offsets[b];
+        for (size_t i = b * block_size; i < std::min(n, (b + 1) * block_size); ++i) {
+            offsets[i] = sum;
+            sum += counts[i];
+        }
+    }
+    offsets[n] = block_offsets[num_blocks];
+}
+
+bool is_start_match(const Overlap& ovl) {
+    // Function returns true if overlap `ovl` is associated with start.
+    return (ovl.terminus_i == START && ovl.terminus_j == END) || (ovl.terminus_i == START && ovl.terminus_j == RCSTART);
+}
+
+bool is_end_match(const Overlap& ovl) {
+    // Function returns true if overlap `ovl` is associated with end.
+    return (ovl.terminus_i == END && ovl.terminus_j == START) || (ovl.terminus_i == END && ovl.terminus_j == RCEND);
+}
+
+typedef bool (*OverlapPredicate)(const Overlap&);
+
+Overlap mirrored_overlap(const Overlap& ovl) {
+    // Function returns the record of the same overlap keyed by the other contig
+    // (the last two columns of `PAIR_CASE_TERMINI` and `SELF_CASE_TERMINI`).
+    // A start matching an rc-start (an end matching an rc-end) is such a match for both
+    // contigs; otherwise the termini trade places.
+    bool keeps_termini = (ovl.terminus_i == START && ovl.terminus_j == RCSTART) ||
+                         (ovl.terminus_i == RCSTART && ovl.terminus_j == START) ||
+                         (ovl.terminus_i == END && ovl.terminus_j == RCEND) ||
+                         (ovl.terminus_i == RCEND && ovl.terminus_j == END);
+    return keeps_termini
+        ? Overlap(ovl.contig_j, ovl.terminus_i, ovl.contig_i, ovl.terminus_j, ovl.ovl_len)
+        : Overlap(ovl.contig_j, ovl.terminus_j, ovl.contig_i, ovl.terminus_i, ovl.ovl_len);
+}
+
+bool _is_self_mirror(const Overlap& ovl) {
+    // Function returns true for a self-overlap that is its own mirrored record
+    return ovl.contig_i == ovl.contig_j && mirrored_overlap(ovl) == ovl;
+}
+
+const int MAX_PACKED_OVERLAP_LEN = (1 << 28) - 1;
+
+class PackedOverlap {
+public:
+    // Конструктор класса PackedOverlap: запись перекрытия в 8 байтах.
+    // Индекс первого контига не хранится (это номер списка в `OverlapCollection`):
+    // биты 0..31 -- contig_j, 32..33 -- terminus_i, 34..35 -- terminus_j,
+    // 36..63 -- длина перекрытия (до MAX_PACKED_OVERLAP_LEN).
+    PackedOverlap() : _bits(0) {}
+    // Длины больше MAX_PACKED_OVERLAP_LEN не помещаются: движки поиска ограничены `maxk`,
+    // а загрузчики графов отбрасывают такие связи.
+    explicit PackedOverlap(const Overlap& ovl) :
+        _bits(static_cast<uint64_t>(static_cast<uint32_t>(ovl.contig_j)) |
+              (static_cast<uint64_t>(ovl.terminus_i) << 32) |
+              (static_cast<uint64_t>(ovl.terminus_j) << 34) |
+              (static_cast<uint64_t>(ovl.ovl_len) << 36)) {
+        assert(ovl.ovl_len >= 0 && ovl.ovl_len <= MAX_PACKED_OVERLAP_LEN);
+    }
+
+    ContigIndex contig_j() const { return static_cast<ContigIndex>(static_cast<uint32_t>(_bits)); }
+
+    // Запись перекрытия контига `contig_i`
+    Overlap unpack(ContigIndex contig_i) const {
+        return Overlap(contig_i, static_cast<Terminus>((_bits >> 32) & 3),
+                       contig_j(), static_cast<Terminus>((_bits >> 34) & 3),
+                       static_cast<int>(_bits >> 36));
+    }
+
+private:
+    uint64_t _bits;
+};
+
+static_assert(sizeof(PackedOverlap) == 8, "PackedOverlap must fit in 8 bytes");
+
+struct _OverlapRows {
+    // Where the records of contig `row` are: its own list and, in the symmetric mode,
+    // the lists of the lower-indexed contigs `sources[sources_begin .. sources_end)`
+    const PackedOverlap* edges;
+    const size_t* offsets;
+    const ContigIndex* sources;
+    ContigIndex row;
+    size_t sources_begin, sources_end;
+    size_t own_begin, own_end;
+    bool symmetric;
+
+    size_t first_record_of(ContigIndex source) const {
+        // Position of the first record of `source` about `row` (lists are ordered by contig_j)
+        const PackedOverlap* first = std::lower_bound(
+            edges + offsets[source], edges + offsets[source + 1], row,
+            [](const PackedOverlap& edge, ContigIndex row) { return edge.contig_j() < row; });
+        return first - edges;
+    }
+};
+
+class OverlapView {
+public:
+    // Конструктор класса OverlapView: перекрытия одного контига, читаемые прямо из
+    // `OverlapCollection` без копирования. В симметричном режиме каждое перекрытие
+    // хранится один раз, в списке контига с меньшим индексом, а записи этого контига
+    // из списков контигов с меньшими индексами и зеркальные записи самоперекрытий
+    // восстанавливаются на лету.
+    OverlapView() : _rows{nullptr, nullptr, nullptr, 0, 0, 0, 0, 0, false} {}
+    explicit OverlapView(const _OverlapRows& rows) : _rows(rows) {}
+
+    class iterator {
+    public:
+        // The current record is built in the iterator, so it is an input iterator
+        typedef std::input_iterator_tag iterator_category;
+        typedef Overlap value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Overlap* pointer;
+        typedef const Overlap& reference;
+
+        iterator(const _OverlapRows& rows, size_t source, size_t pos) :
+            _rows(rows), _source(source), _pos(pos), _mirror(false) { _settle(); }
+
+        const Overlap& operator*() const { return _current; }
+        const Overlap* operator->() const { return &_current; }
+
+        iterator& operator++() {
+            if (_source == _rows.sources_end && _rows.symmetric && !_mirror &&
+                _current.contig_j == _rows.row && !_is_self_mirror(_current)) {
+                // Mirrored record of a self-overlap follows the stored one
+                _mirror = true;
+            } else {
+                _mirror = false;
+                ++_pos;
+            }
+            _settle();
+            return *this;
+        }
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+
+        bool operator==(const iterator& other) const {
+            return _source == other._source && _pos == other._pos && _mirror == other._mirror;
+        }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+
+    private:
+        _OverlapRows _rows;
+        size_t _source;  // position in `sources`; `_pos` is in the source's list until they end
+        size_t _pos;
+        bool _mirror;
+        Overlap _current;
+
+        void _settle() {
+            // Skip to the next existing record (if any) and build it in `_current`
+            while (_source != _rows.sources_end) {
+                ContigIndex source = _rows.sources[_source];
+                if (_pos < _rows.offsets[source + 1] && _rows.edges[_pos].contig_j() == _rows.row) {
+                    _current = mirrored_overlap(_rows.edges[_pos].unpack(source));
+                    return;
+                }
+                ++_source;
+                _pos = _source != _rows.sources_end ? _rows.first_record_of(_rows.sources[_source]) : _rows.own_begin;
+            }
+            if (_pos != _rows.own_end) {
+                Overlap ovl = _rows.edges[_pos].unpack(_rows.row);
+                _current = _mirror ? mirrored_overlap(ovl) : ovl;
+            }
+        }
+    };
+
+    iterator begin() const {
+        return iterator(_rows, _rows.sources_begin, _rows.sources_begin != _rows.sources_end
+                        ? _rows.first_record_of(_rows.sources[_rows.sources_begin]) : _rows.own_begin);
+    }
+    iterator end() const { return iterator(_rows, _rows.sources_end, _rows.own_end); }
+    bool empty() const { return begin() == end(); }
+    size_t size() const { return std::distance(begin(), end()); }
+
+private:
+    _OverlapRows _rows;
+};
+
+class FilteredOverlapView {
+public:
+    // Конструктор класса FilteredOverlapView: перекрытия из `overlaps`,
+    // для которых выполняется `predicate`, без копирования
+    FilteredOverlapView(OverlapView overlaps, OverlapPredicate predicate) :
+        _overlaps(overlaps), _predicate(predicate) {}
+
+    class iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef Overlap value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Overlap* pointer;
+        typedef const Overlap& reference;
+
+        iterator(OverlapView::iterator pos, OverlapView::iterator end, OverlapPredicate predicate) :
+            _pos(pos), _end(end), _predicate(predicate) { _skip(); }
+
+        const Overlap& operator*() const { return *_pos; }
+        const Overlap* operator->() const { return &*_pos; }
+        iterator& operator++() { ++_pos; _skip(); return *this; }
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+        bool operator==(const iterator& other) const { return _pos == other._pos; }
+        bool operator!=(const iterator& other) const { return _pos != other._pos; }
+
+    private:
+        OverlapView::iterator _pos;
+        OverlapView::iterator _end;
+        OverlapPredicate _predicate;
+
+        void _skip() {
+            while (_pos != _end && !_predicate(*_pos)) ++_pos;
+        }
+    };
+
+    iterator begin() const { return iterator(_overlaps.begin(), _overlaps.end(), _predicate); }
+    iterator end() const { return iterator(_overlaps.end(), _overlaps.end(), _predicate); }
+    bool empty() const { return begin() == end(); }
+    size_t size() const { return std::distance(begin(), end()); }
+
+private:
+    OverlapView _overlaps;
+    OverlapPredicate _predicate;
+};
+
 class OverlapCollection {
 public:
     // Конструктор класса OverlapCollection
-    OverlapCollection() {}
+    OverlapCollection() : _offsets(1, 0), _source_offsets(1, 0), _num_keys(0), _symmetric(true) {}
+
+    // Конструктор из буферов перекрытий (например, по одному на поток). Каждое перекрытие
+    // передаётся один раз, любой из двух своих записей; зеркальная запись строится
+    // по `mirrored_overlap`. Списки хранятся подряд в одном массиве упакованных записей
+    // (compressed sparse row): подсчёт, префиксные суммы и раскладка выполняются
+    // параллельно, затем каждый список упорядочивается по `_overlap_order`, поэтому
+    // результат не зависит от порядка записей в буферах. Буферы освобождаются.
+    // `symmetric`: хранить каждое перекрытие один раз (в списке контига с меньшим индексом)
+    // вместо двух записей, по одной в списке каждого контига.
+    OverlapCollection(size_t num_contigs, std::vector<std::vector<Overlap>>& buffers,
+                      bool symmetric = true) : _num_keys(0), _symmetric(symmetric) {
+        // Records stored in the list of contig_i: the one keyed by the lower index
+        // (for a self-overlap, the one that goes first in `_overlap_order`) and,
+        // unless symmetric, its mirrored record
+        auto canonical = [](const Overlap& ovl) {
+            Overlap mirror = mirrored_overlap(ovl);
+            if (ovl.contig_j != ovl.contig_i) {
+                return ovl.contig_j > ovl.contig_i ? ovl : mirror;
+            }
+            return _overlap_rank(mirror) < _overlap_rank(ovl) ? mirror : ovl;
+        };
+        auto has_mirror = [symmetric](const Overlap& ovl) { return !symmetric && !_is_self_mirror(ovl); };
+
+        // Start and end degrees count both records of an overlap (one for a self-overlap
+        // that is its own mirrored record), whichever of them are stored
+        _start_degrees.assign(num_contigs, 0);
+        _end_degrees.assign(num_contigs, 0);
+        auto count_degree = [&](const Overlap& record) {
+            if (is_start_match(record)) {
+                #pragma omp atomic
+                _start_degrees[record.contig_i]++;
+            } else if (is_end_match(record)) {
+                #pragma omp atomic
+                _end_degrees[record.contig_i]++;
+            }
+        };
+
+        std::vector<size_t> counts(num_contigs, 0);
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t b = 0; b < buffers.size(); ++b) {
+            for (const Overlap& ovl : buffers[b]) {
+                Overlap record = canonical(ovl);
+                #pragma omp atomic
+                counts[record.contig_i]++;
+                if (has_mirror(record)) {
+                    #pragma omp atomic
+                    counts[record.contig_j]++;
+                }
+                count_degree(record);
+                if (!_is_self_mirror(record)) {
+                    count_degree(mirrored_overlap(record));
+                }
+            }
+        }
+        _exclusive_scan(counts, _offsets);
+
+        std::vector<size_t> cursors(_offsets.begin(), _offsets.end() - 1);
+        _edges.resize(_offsets[num_contigs]);
+        auto place = [&](const Overlap& record) {
+            size_t slot;
+            #pragma omp atomic capture
+            slot = cursors[record.contig_i]++;
+            _edges[slot] = PackedOverlap(record);
+        };
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t b = 0; b < buffers.size(); ++b) {
+            for (const Overlap& ovl : buffers[b]) {
+                Overlap record = canonical(ovl);
+                place(record);
+                if (has_mirror(record)) {
+                    place(mirrored_overlap(record));
+                }
+            }
+            std::vector<Overlap>().swap(buffers[b]);
+        }
+
+        // Number of other contigs j > c each list refers to, i.e. of sources of contig j
+        std::vector<size_t> source_counts(symmetric ? num_contigs : 0, 0);
+        #pragma omp parallel for schedule(dynamic, 1024)
+        for (size_t c = 0; c < num_contigs; ++c) {
+            std::sort(_edges.begin() + _offsets[c], _edges.begin() + _offsets[c + 1],
+                      [c](const PackedOverlap& a, const PackedOverlap& b) {
+                          return _overlap_order(a.unpack(c), b.unpack(c));
+                      });
+            if (symmetric) {
+                for (size_t e = _offsets[c]; e < _offsets[c + 1]; ++e) {
+                    ContigIndex j = _edges[e].contig_j();
+                    if (static_cast<size_t>(j) != c && (e == _offsets[c] || _edges[e - 1].contig_j() != j)) {
+                        #pragma omp atomic
+                        source_counts[j]++;
+                    }
+                }
+            }
+        }
+
+        // Reverse index: for each contig, the lower-indexed contigs whose lists hold its overlaps
+        _exclusive_scan(source_counts, _source_offsets);
+        _sources.resize(_source_offsets.back());
+        if (symmetric) {
+            std::vector<size_t> source_cursors(_source_offsets.begin(), _source_offsets.end() - 1);
+            #pragma omp parallel for schedule(dynamic, 1024)
+            for (size_t c = 0; c < num_contigs; ++c) {
+                for (size_t e = _offsets[c]; e < _offsets[c + 1]; ++e) {
+                    ContigIndex j = _edges[e].contig_j();
+                    if (static_cast<size_t>(j) != c && (e == _offsets[c] || _edges[e - 1].contig_j() != j)) {
+                        size_t slot;
+                        #pragma omp atomic capture
+                        slot = source_cursors[j]++;
+                        _sources[slot] = static_cast<ContigIndex>(c);
+                    }
+                }
+            }
+        }
 
-    // Метод для получения списка перекрытий, связанных с контигом по его ключу
-    std::vector<Overlap> operator[](ContigIndex key) const {
-        auto it = _collection.find(key);
-        if (it != _collection.end()) {
-            return it->second;
-        } else {
-            return std::vector<Overlap>(); // Возвращаем пустой вектор, если ключ не найден
+        size_t num_keys = 0;
+        #pragma omp parallel for schedule(dynamic, 1024) reduction(+:num_keys)
+        for (size_t c = 0; c < num_contigs; ++c) {
+            if (symmetric) {
+                std::sort(_sources.begin() + _source_offsets[c], _sources.begin() + _source_offsets[c + 1]);
+            }
+            num_keys += counts[c] > 0 || (symmetric && source_counts[c] > 0);
+        }
+        _num_keys = num_keys;
+    }
+
+    // Метод для получения списка перекрытий, связанных с контигом по его ключу (без копирования)
+    OverlapView operator[](ContigIndex key) const {
+        if (key < 0 || static_cast<size_t>(key) + 1 >= _offsets.size()) {
+            return OverlapView(); // Пустой список, если ключ не найден
         }
+        size_t sources_begin = _symmetric ? _source_offsets[key] : 0;
+        size_t sources_end = _symmetric ? _source_offsets[key + 1] : 0;
+        return OverlapView(_OverlapRows{_edges.data(), _offsets.data(), _sources.data(), key,
+                                        sources_begin, sources_end, _offsets[key], _offsets[key + 1], _symmetric});
     }
 
-    // Метод для получения размера коллекции
+    // Перекрытия контига, удовлетворяющие `predicate`
+    FilteredOverlapView filter(ContigIndex key, OverlapPredicate predicate) const {
+        return FilteredOverlapView((*this)[key], predicate);
+    }
+
+    // Перекрытия, связанные с началом (концом) контига
+    FilteredOverlapView start_matches(ContigIndex key) const { return filter(key, is_start_match); }
+    FilteredOverlapView end_matches(ContigIndex key) const { return filter(key, is_end_match); }
+
+    // Метод для получения размера коллекции (число контигов, у которых есть перекрытия)
     size_t size() const {
-        return _collection.size();
+        return _num_keys;
+    }
+
+    // Каждое перекрытие хранится один раз
+    bool is_symmetric() const {
+        return _symmetric;
+    }
+
+    // Число перекрытий контига, связанных с его началом (`is_start_match`)
+    int start_degree(ContigIndex key) const {
+        return key >= 0 && static_cast<size_t>(key) < _start_degrees.size() ? _start_degrees[key] : 0;
     }
 
-    // Метод для добавления перекрытия в коллекцию
-    void add_overlap(ContigIndex key, const Overlap& overlap) {
-        _collection[key].push_back(overlap);
+    // Число перекрытий контига, связанных с его концом (`is_end_match`)
+    int end_degree(ContigIndex key) const {
+        return key >= 0 && static_cast<size_t>(key) < _end_degrees.size() ? _end_degrees[key] : 0;
     }
 
     // Переопределение оператора преобразования в строку
-    std::string to_string() const {
+    std::string to_string() const {                      /////////Не используется (для тестов)
         std::string result = "{";
-        for (const auto& pair : _collection) {
-            result += std::to_string(pair.first) + ": [";
-            for (const auto& overlap : pair.second) {
-                result += overlap.to_string() + ", ";
+        for (size_t key = 0; key + 1 < _offsets.size(); ++key) {
+            OverlapView overlaps = (*this)[key];
+            if (overlaps.empty()) {
+                continue;
+            }
+            result += std::to_string(key) + ": [";
+            for (const Overlap& ovl : overlaps) {
+                result += ovl.to_string() + ", ";
             }
             result += "], ";
         }
@@ -106,145 +560,666 @@ public:
         return result;
     }
 
-    // Добавим методы begin и end для использования в цикле for
-    auto begin() const { return std::begin(_collection); }
-    auto end() const { return std::end(_collection); }
-
 private:
-    // Словарь, хранящий списки перекрытий для каждого контига
-    std::unordered_map<ContigIndex, std::vector<Overlap>> _collection;
+    std::vector<size_t> _offsets;         // список контига c: _edges[_offsets[c] .. _offsets[c + 1])
+    std::vector<PackedOverlap> _edges;
+    std::vector<size_t> _source_offsets;  // симметричный режим: _sources[_source_offsets[c] .. _source_offsets[c + 1])
+    std::vector<ContigIndex> _sources;
+    std::vector<int> _start_degrees;
+    std::vector<int> _end_degrees;
+    size_t _num_keys;
+    bool _symmetric;
 };
 
-int find_overlap_s2s(const std::string& seq1, const std::string& seq2, int mink, int maxk) {
+// Overlap kernels. The overlap is the longest length in `mink`..`maxk`
+// (and not longer than any of the two sequences) for which the condition holds, 0 if none.
+// Equal prefixes (suffixes) of length i imply equal prefixes (suffixes) of every shorter
+// length, so for s2s and e2e the answer is the common prefix (suffix) length, found with
+// a single scan that stops at the first mismatch.
+
+int find_overlap_s2s(std::string_view seq1, std::string_view seq2, int mink, int maxk) {
     maxk = std::min(maxk, std::min(static_cast<int>(seq1.length()), static_cast<int>(seq2.length())));
     if (maxk < mink) return 0;
 
     int overlap = 0;
-    for (int i = mink; i <= maxk; ++i) {
-        if (std::equal(seq1.begin(), seq1.begin() + i, seq2.begin())) {
-            overlap = i;
-        }
+    while (overlap < maxk && seq1[overlap] == seq2[overlap]) {
+        overlap++;
     }
-    return overlap;
+    return overlap >= mink ? overlap : 0;
 }
 
-int find_overlap_e2s(const std::string& seq1, const std::string& seq2, int mink, int maxk) {
+int find_overlap_e2s(std::string_view seq1, std::string_view seq2, int mink, int maxk) {
     maxk = std::min(maxk, std::min(static_cast<int>(seq1.length()), static_cast<int>(seq2.length())));
     if (maxk < mink) return 0;
 
-    int overlap = 0;
-    for (int i = mink; i <= maxk; ++i) {
-        if (std::equal(seq1.end() - i, seq1.end(), seq2.begin(), seq2.begin() + i)) {
-            overlap = i;
+    // The longest overlap wins, so check from the longest length down and stop at the first match
+    for (int i = maxk; i >= mink; --i) {
+        if (std::equal(seq1.end() - i, seq1.end(), seq2.begin())) {
+            return i;
         }
     }
-    return overlap;
+    return 0;
 }
 
-int find_overlap_e2e(const std::string& seq1, const std::string& seq2, int mink, int maxk) {
+int find_overlap_e2e(std::string_view seq1, std::string_view seq2, int mink, int maxk) {
     maxk = std::min(maxk, std::min(static_cast<int>(seq1.length()), static_cast<int>(seq2.length())));
     if (maxk < mink) return 0;
 
     int overlap = 0;
-    for (int i = mink; i <= maxk; ++i) {
-        if (std::equal(seq1.end() - i, seq1.end(), seq2.end() - i, seq2.end())) {
-            overlap = i;
+    while (overlap < maxk && seq1[seq1.length() - 1 - overlap] == seq2[seq2.length() - 1 - overlap]) {
+        overlap++;
+    }
+    return overlap >= mink ? overlap : 0;
+}
+
+const uint64_t TERMINUS_HASH_BASE = 0x9e3779b97f4a7c15ULL;
+
+class TerminusHashes {
+public:
+    // Конструктор класса TerminusHashes. Для каждого контига один раз считает
+    // полиномиальные хеши (mod 2^64) всех префиксов start и rcend и всех суффиксов
+    // end и rcstart длиной до `maxk` (эти термины участвуют в find_overlap_e2s).
+    // Хеш строки x длины L: x[0]*B^(L-1) + ... + x[L-1], поэтому суффикс и префикс
+    // из одинаковых символов имеют одинаковый хеш.
+    TerminusHashes(const ContigCollection& contig_collection, int maxk) :
+        _stride(maxk + 1), _hashes(contig_collection.size() * 4 * (maxk + 1), 0) {
+
+        #pragma omp parallel for
+        for (size_t c = 0; c < contig_collection.size(); ++c) {
+            ContigTermini termini = contig_collection.termini(c);
+            _prefix_hashes(termini.start, _row(c, 0));
+            _suffix_hashes(termini.end, _row(c, 1));
+            _suffix_hashes(termini.rcstart, _row(c, 2));
+            _prefix_hashes(termini.rcend, _row(c, 3));
         }
     }
-    return overlap;
+
+    // Element [L] is the hash of the L-long prefix (suffix), L = 0..min(maxk, terminus length)
+    const uint64_t* start_pfx(ContigIndex c) const { return _row(c, 0); }
+    const uint64_t* end_sfx(ContigIndex c) const { return _row(c, 1); }
+    const uint64_t* rcstart_sfx(ContigIndex c) const { return _row(c, 2); }
+    const uint64_t* rcend_pfx(ContigIndex c) const { return _row(c, 3); }
+
+    // The same rows by canonical terminus (see `PackedTermini`): prefix hashes of the inward
+    // terminus and hashes of its reverse-complemented prefixes
+    const uint64_t* pfx(ContigIndex c, int strand) const { return strand == STRAND_FORWARD ? start_pfx(c) : rcend_pfx(c); }
+    const uint64_t* rc_pfx(ContigIndex c, int strand) const { return strand == STRAND_FORWARD ? rcstart_sfx(c) : end_sfx(c); }
+
+private:
+    size_t _stride;
+    std::vector<uint64_t> _hashes;
+
+    uint64_t* _row(size_t c, int kind) { return _hashes.data() + (4 * c + kind) * _stride; }
+    const uint64_t* _row(size_t c, int kind) const { return _hashes.data() + (4 * c + kind) * _stride; }
+
+    void _prefix_hashes(std::string_view seq, uint64_t* hashes) const {
+        size_t len = std::min(seq.length(), _stride - 1);
+        for (size_t i = 0; i < len; ++i) {
+            hashes[i + 1] = hashes[i] * TERMINUS_HASH_BASE + static_cast<unsigned char>(seq[i]);
+        }
+    }
+
+    void _suffix_hashes(std::string_view seq, uint64_t* hashes) const {
+        size_t len = std::min(seq.length(), _stride - 1);
+        uint64_t base_pow = 1;
+        for (size_t i = 0; i < len; ++i) {
+            hashes[i + 1] = hashes[i] + static_cast<unsigned char>(seq[seq.length() - 1 - i]) * base_pow;
+            base_pow *= TERMINUS_HASH_BASE;
+        }
+    }
+};
+
+int find_overlap_e2s(std::string_view seq1, const uint64_t* seq1_sfx_hashes,
+                     std::string_view seq2, const uint64_t* seq2_pfx_hashes,
+                     int mink, int maxk) {
+    // Same as `find_overlap_e2s` above, with precomputed suffix hashes of `seq1` and
+    // prefix hashes of `seq2` (see `TerminusHashes`): each length costs one comparison
+    // of two hashes and only a hash match is verified character by character.
+    maxk = std::min(maxk, std::min(static_cast<int>(seq1.length()), static_cast<int>(seq2.length())));
+    if (maxk < mink) return 0;
+
+    for (int i = maxk; i >= mink; --i) {
+        if (seq1_sfx_hashes[i] == seq2_pfx_hashes[i] &&
+            std::equal(seq1.end() - i, seq1.end(), seq2.begin())) {
+            return i;
+        }
+    }
+    return 0;
 }
 
-OverlapCollection detect_adjacent_contigs(const ContigCollection& contig_collection,
-                                          int mink, int maxk) {
-    OverlapCollection overlap_collection;
-    int num_contigs = contig_collection.size();
-    
-    #pragma omp parallel for schedule(dynamic) // Enable OpenMP parallelization
-    for (ContigIndex i = 0; i < num_contigs; i++) {
-        if (contig_collection[i].length <= mink) {
-            std::cout << "\r" << i + 1 << "/" << num_contigs;
-            continue;
+// Packed kernels over canonical termini (see `PackedTermini`): the same results as
+// the string kernels, with 32 bases compared per 64-bit word.
+
+int find_overlap_s2s(const PackedTerminus& seq1, const PackedTerminus& seq2, int mink, int maxk) {
+    maxk = std::min(maxk, std::min(seq1.length, seq2.length));
+    if (maxk < mink) return 0;
+
+    int overlap = packed_common_prefix(seq1, seq2, maxk);
+    return overlap >= mink ? overlap : 0;
+}
+
+int find_overlap_rc_join(const PackedTerminus& seq1, const uint64_t* seq1_pfx_hashes,
+                         const PackedTerminus& seq2, const uint64_t* seq2_rc_pfx_hashes,
+                         int mink, int maxk) {
+    // Function returns the longest length L for which the L-long prefix of `seq1` is the
+    // reverse complement of the L-long prefix of `seq2`, i.e. the two ends join head to head.
+    // Every e2s case is such a join of two inward termini: `seq1` is the prefix (`start`
+    // or `rcend`), `seq2` gives the suffix (`end` or `rcstart`), as in `packed_rc_equal`.
+    maxk = std::min(maxk, std::min(seq1.length, seq2.length));
+    if (maxk < mink) return 0;
+
+    for (int i = maxk; i >= mink; --i) {
+        if (seq1_pfx_hashes[i] == seq2_rc_pfx_hashes[i] && packed_rc_equal(seq1, seq2, i)) {
+            return i;
         }
+    }
+    return 0;
+}
+
+// Orientation cases of a pair of canonical termini {strand of i, strand of j}:
+// their common prefix is one of the s2s/e2e cases 4-7, their head-to-head join
+// one of the e2s cases 0-3.
+const int CANONICAL_SHARED_CASE[2][2] = {
+    {4, 6},  // start-start, start-rcend
+    {7, 5}   // rcend-start, rcend-rcend
+};
+const int CANONICAL_JOIN_CASE[2][2] = {
+    {2, 0},
+    {1, 3}
+};
+
+void _add_pair_overlaps(std::vector<Overlap>& overlaps, ContigIndex i, ContigIndex j,
+                        int pair_case, int ovl_len) {
+    // Only the record keyed by i is added; `OverlapCollection` derives the mirrored one
+    const Terminus* termini = PAIR_CASE_TERMINI[pair_case];
+    overlaps.emplace_back(i, termini[0], j, termini[1], ovl_len);
+}
+
+struct _PairwiseTile {
+    // Block [row_begin, row_end) x [col_begin, col_end) of the upper triangle of pairs
+    ContigIndex row_begin, row_end;
+    ContigIndex col_begin, col_end;
+};
+
+struct alignas(64) _TileCursor {
+    // Next unclaimed tile of a thread's share of the tile list, and the end of the share
+    std::atomic<size_t> next;
+    size_t end;
+};
+
+// Load balance of one thread of the all-pairs search
+struct SearchThreadStats {
+    double busy_seconds;  // time spent checking tiles
+    size_t own_tiles;     // tiles of the thread's own share
+    size_t stolen_tiles;  // tiles taken from the other shares
+};
+
+int _pairwise_tile_size(int num_contigs, int maxk) {
+    // Function picks the tile side so that the hashes and packed termini of the
+    // contigs of one tile row and one tile column (about 512 KB) stay in the L2 cache.
+    size_t bytes_per_contig = 4 * (maxk + 1) * sizeof(uint64_t) + 2 * ((maxk + 31) / 32 + 1) * sizeof(uint64_t);
+    int tile_size = static_cast<int>((512 << 10) / (2 * bytes_per_contig));
+    return std::max(16, std::min(tile_size, std::max(num_contigs, 1)));
+}
+
+OverlapCollection detect_adjacent_contigs_pairwise(const ContigCollection& contig_collection,
+                                                   int mink, int maxk,
+                                                   std::vector<SearchThreadStats>* thread_stats = nullptr) {
+    // Reference all-pairs search: every pair (i, j) is checked in all eight orientations.
+    // O(n^2) pairs; cheaper than the indexed search only for small collections.
+    // Each contig keeps only its two canonical (inward) termini, and the eight cases are
+    // the common prefix and the head-to-head join of the four pairs of them.
+    //
+    // The upper triangle of pairs is cut into cache-sized tiles. Every thread gets a share
+    // of tiles of about equal work and, when done with it, steals tiles from the other
+    // shares. Threads append overlaps to their own buffers, merged into `OverlapCollection`
+    // in an order that does not depend on the number of threads.
+    // The busy time and tile counts of every thread are stored in `thread_stats`, if given.
+    int num_contigs = contig_collection.size();
+
+    // Hashes of all terminus prefixes/suffixes, computed once per contig;
+    // the 2-bit packed termini are those of `ContigTable`
+    const TerminusHashes hashes(contig_collection, maxk);
 
-        std::vector<Overlap> local_overlaps;
+    auto is_row = [&](ContigIndex i) { return contig_collection[i].length > mink; };
 
-        // Check self-overlaps first
-        int ovl_len = find_overlap_e2s(contig_collection[i].end,
-                                     contig_collection[i].start,
-                                     mink, maxk);
+    auto check_self = [&](ContigIndex i, std::vector<Overlap>& overlaps) {
+        const PackedTerminus forward = contig_collection.inward(i, STRAND_FORWARD);
+        const PackedTerminus reverse = contig_collection.inward(i, STRAND_REVERSE);
+
+        int ovl_len = find_overlap_rc_join(forward, hashes.pfx(i, STRAND_FORWARD),
+                                           reverse, hashes.rc_pfx(i, STRAND_REVERSE), mink, maxk);
         if (ovl_len > 0 && ovl_len < contig_collection[i].length) {
-            local_overlaps.emplace_back(i, END, i, START, ovl_len);
-            local_overlaps.emplace_back(i, START, i, END, ovl_len);
+            overlaps.emplace_back(i, END, i, START, ovl_len);
         }
 
-        ovl_len = find_overlap_s2s(contig_collection[i].start,
-                                  contig_collection[i].rcend,
-                                  mink, maxk);
+        ovl_len = find_overlap_s2s(forward, reverse, mink, maxk);
         if (ovl_len != 0) {
-            local_overlaps.emplace_back(i, START, i, RCEND, ovl_len);
-            local_overlaps.emplace_back(i, RCEND, i, START, ovl_len);
+            overlaps.emplace_back(i, START, i, RCEND, ovl_len);
         }
+    };
 
-        // Compare with other contigs
-        for (ContigIndex j = i + 1; j < num_contigs; j++) {
-            // Pre-calculate all possible overlaps for this pair
-            std::array<int, 8> overlaps = {
-                find_overlap_e2s(contig_collection[j].end, contig_collection[i].start, mink, maxk),
-                find_overlap_e2s(contig_collection[i].end, contig_collection[j].start, mink, maxk),
-                find_overlap_e2s(contig_collection[j].rcstart, contig_collection[i].start, mink, maxk),
-                find_overlap_e2s(contig_collection[i].end, contig_collection[j].rcend, mink, maxk),
-                find_overlap_s2s(contig_collection[i].start, contig_collection[j].start, mink, maxk),
-                find_overlap_e2e(contig_collection[i].end, contig_collection[j].end, mink, maxk),
-                find_overlap_s2s(contig_collection[i].start, contig_collection[j].rcend, mink, maxk),
-                find_overlap_e2e(contig_collection[i].end, contig_collection[j].rcstart, mink, maxk)
-            };
+    auto check_pair = [&](ContigIndex i, ContigIndex j, std::vector<Overlap>& overlaps) {
+        // Pre-calculate all possible overlaps for this pair
+        std::array<int, 8> ovl_lens;
+        for (int strand_i = 0; strand_i < 2; ++strand_i) {
+            const PackedTerminus ti = contig_collection.inward(i, strand_i);
+            for (int strand_j = 0; strand_j < 2; ++strand_j) {
+                const PackedTerminus tj = contig_collection.inward(j, strand_j);
+                ovl_lens[CANONICAL_SHARED_CASE[strand_i][strand_j]] = find_overlap_s2s(ti, tj, mink, maxk);
+                // Cases 0 and 2 have the prefix on i, cases 1 and 3 on j
+                ovl_lens[CANONICAL_JOIN_CASE[strand_i][strand_j]] = strand_i == STRAND_FORWARD
+                    ? find_overlap_rc_join(ti, hashes.pfx(i, strand_i), tj, hashes.rc_pfx(j, strand_j), mink, maxk)
+                    : find_overlap_rc_join(tj, hashes.pfx(j, strand_j), ti, hashes.rc_pfx(i, strand_i), mink, maxk);
+            }
+        }
 
-            // Add non-zero overlaps
-            if (overlaps[0] != 0) {
-                local_overlaps.emplace_back(i, START, j, END, overlaps[0]);
-                local_overlaps.emplace_back(j, END, i, START, overlaps[0]);
+        for (int c = 0; c < 8; ++c) {
+            if (ovl_lens[c] != 0) {
+                _add_pair_overlaps(overlaps, i, j, c, ovl_lens[c]);
             }
-            if (overlaps[1] != 0) {
-                local_overlaps.emplace_back(i, END, j, START, overlaps[1]);
-                local_overlaps.emplace_back(j, START, i, END, overlaps[1]);
+        }
+    };
+
+    // Cut the triangle into tiles in row-major order and weigh them by the number of pairs
+    int tile_size = _pairwise_tile_size(num_contigs, maxk);
+    std::vector<_PairwiseTile> tiles;
+    std::vector<size_t> tile_work_end; // cumulative work up to and including each tile
+    size_t total_work = 0;
+    for (ContigIndex row = 0; row < num_contigs; row += tile_size) {
+        ContigIndex row_end = std::min(row + tile_size, num_contigs);
+        size_t num_rows = 0;
+        for (ContigIndex i = row; i < row_end; ++i) {
+            num_rows += is_row(i);
+        }
+        for (ContigIndex col = row; col < num_contigs; col += tile_size) {
+            ContigIndex col_end = std::min(col + tile_size, num_contigs);
+            // Diagonal tiles hold a triangle; self checks count as one pair
+            size_t work = col == row ? num_rows * (col_end - col + 1) / 2 : num_rows * (col_end - col);
+            if (work == 0) {
+                continue;
             }
-            if (overlaps[2] != 0) {
-                local_overlaps.emplace_back(i, START, j, RCSTART, overlaps[2]);
-                local_overlaps.emplace_back(j, START, i, RCSTART, overlaps[2]);
+            tiles.push_back(_PairwiseTile{row, row_end, col, col_end});
+            total_work += work;
+            tile_work_end.push_back(total_work);
+        }
+    }
+
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    // Thread t owns the tiles whose cumulative work ends in the t-th equal slice of the total
+    std::vector<_TileCursor> cursors(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+        size_t work_begin = total_work * t / num_threads;
+        size_t work_end = total_work * (t + 1) / num_threads;
+        cursors[t].next = std::upper_bound(tile_work_end.begin(), tile_work_end.end(), work_begin) - tile_work_end.begin();
+        cursors[t].end = std::upper_bound(tile_work_end.begin(), tile_work_end.end(), work_end) - tile_work_end.begin();
+    }
+    cursors[num_threads - 1].end = tiles.size();
+
+    std::vector<std::vector<Overlap>> thread_overlaps(num_threads);
+    std::vector<double> busy_seconds(num_threads, 0);
+    std::vector<size_t> own_tiles(num_threads, 0);
+    std::vector<size_t> stolen_tiles(num_threads, 0);
+    std::atomic<size_t> tiles_done(0);
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int t = 0;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+#endif
+        std::vector<Overlap>& overlaps = thread_overlaps[t];
+
+        // Own share first, then the other shares in turn
+        for (int k = 0; k < num_threads; ++k) {
+            _TileCursor& cursor = cursors[(t + k) % num_threads];
+            for (size_t tile_index = cursor.next++; tile_index < cursor.end; tile_index = cursor.next++) {
+                auto start_time = std::chrono::high_resolution_clock::now();
+
+                const _PairwiseTile& tile = tiles[tile_index];
+                for (ContigIndex i = tile.row_begin; i < tile.row_end; ++i) {
+                    if (!is_row(i)) {
+                        continue;
+                    }
+                    if (tile.col_begin == tile.row_begin) {
+                        check_self(i, overlaps);
+                    }
+                    for (ContigIndex j = std::max(tile.col_begin, i + 1); j < tile.col_end; ++j) {
+                        check_pair(i, j, overlaps);
+                    }
+                }
+
+                auto end_time = std::chrono::high_resolution_clock::now();
+                busy_seconds[t] += std::chrono::duration<double>(end_time - start_time).count();
+                (k == 0 ? own_tiles : stolen_tiles)[t]++;
+                size_t done = ++tiles_done;
+                if (t == 0) {
+                    std::cout << "\r" << done << "/" << tiles.size();
+                }
             }
-            if (overlaps[3] != 0) {
-                local_overlaps.emplace_back(i, END, j, RCEND, overlaps[3]);
-                local_overlaps.emplace_back(j, END, i, RCEND, overlaps[3]);
+        }
+    }
+    std::cout << "\r" << tiles.size() << "/" << tiles.size() << std::endl;
+
+    if (thread_stats != nullptr) {
+        thread_stats->clear();
+        for (int t = 0; t < num_threads; ++t) {
+            thread_stats->push_back(SearchThreadStats{busy_seconds[t], own_tiles[t], stolen_tiles[t]});
+        }
+    }
+
+    // Each thread appended to its own buffer; the lists are merged and ordered in parallel
+    return OverlapCollection(num_contigs, thread_overlaps);
+}
+
+OverlapCollection detect_adjacent_contigs_exact_k(const ContigCollection& contig_collection, int k) {
+    // Fast path for de Bruijn assemblies (SPAdes, MEGAHIT, Velvet), where adjacent
+    // contigs overlap by exactly the assembly `k`. Each k-long terminus is hashed
+    // once and all eight orientation cases are resolved by hash-table lookups,
+    // in expected O(n + number of overlaps) time. The result is the same as
+    // `detect_adjacent_contigs(contig_collection, k, k)`.
+    // Contig termini must be at least `k` long (`get_contig_collection` with maxk >= k).
+    int num_contigs = contig_collection.size();
+
+    typedef std::unordered_map<std::string_view, std::vector<ContigIndex>> TerminusIndex;
+
+    // k-long termini of a contig, as views into its terminus strings
+    const TerminusStrings strings(contig_collection);
+    auto start_k = [&](ContigIndex c) { return strings.start(c).substr(0, k); };
+    auto end_k = [&](ContigIndex c) {
+        std::string_view end = strings.end(c);
+        return end.substr(end.length() - k);
+    };
+    auto rcstart_k = [&](ContigIndex c) {
+        std::string_view rcstart = strings.rcstart(c);
+        return rcstart.substr(rcstart.length() - k);
+    };
+    auto rcend_k = [&](ContigIndex c) { return strings.rcend(c).substr(0, k); };
+    auto has_k_termini = [&](ContigIndex c) {
+        return static_cast<int>(strings.start(c).length()) >= k;
+    };
+
+    // Index every terminus kind; contig indices in each bucket are ascending
+    TerminusIndex start_index, end_index, rcstart_index, rcend_index;
+    for (ContigIndex c = 0; c < num_contigs; ++c) {
+        if (!has_k_termini(c)) continue;
+        start_index[start_k(c)].push_back(c);
+        end_index[end_k(c)].push_back(c);
+        rcstart_index[rcstart_k(c)].push_back(c);
+        rcend_index[rcend_k(c)].push_back(c);
+    }
+
+    // For every orientation case: which index to look up and with which terminus of i
+    // (the same checks as in `detect_adjacent_contigs`)
+    const TerminusIndex* case_index[8] = {
+        &end_index, &start_index, &rcstart_index, &rcend_index,
+        &start_index, &end_index, &rcend_index, &rcstart_index
+    };
+    const bool case_uses_start[8] = {true, false, true, false, true, false, true, false};
+
+    std::vector<std::vector<Overlap>> row_overlaps(num_contigs);
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (ContigIndex i = 0; i < num_contigs; i++) {
+        // Same eligibility as the general search with mink == maxk == k
+        if (contig_collection[i].length <= k || !has_k_termini(i)) {
+            continue;
+        }
+        std::vector<Overlap>& local_overlaps = row_overlaps[i];
+
+        // Self-overlaps
+        if (end_k(i) == start_k(i)) {
+            local_overlaps.emplace_back(i, END, i, START, k);
+        }
+        if (start_k(i) == rcend_k(i)) {
+            local_overlaps.emplace_back(i, START, i, RCEND, k);
+        }
+
+        // Matches with other contigs j > i, as (j, case) pairs
+        std::vector<std::pair<ContigIndex, int>> matches;
+        for (int c = 0; c < 8; ++c) {
+            auto it = case_index[c]->find(case_uses_start[c] ? start_k(i) : end_k(i));
+            if (it == case_index[c]->end()) continue;
+            const std::vector<ContigIndex>& bucket = it->second;
+            for (auto j = std::upper_bound(bucket.begin(), bucket.end(), i); j != bucket.end(); ++j) {
+                matches.emplace_back(*j, c);
             }
-            if (overlaps[4] != 0) {
-                local_overlaps.emplace_back(i, START, j, START, overlaps[4]);
-                local_overlaps.emplace_back(j, START, i, START, overlaps[4]);
+        }
+
+        // Emit in the order of the all-pairs loop: by j, then by case
+        std::sort(matches.begin(), matches.end());
+        for (const auto& [j, c] : matches) {
+            _add_pair_overlaps(local_overlaps, i, j, c, k);
+        }
+    }
+
+    return OverlapCollection(num_contigs, row_overlaps);
+}
+
+
+struct _TerminusHashState {
+    // Polynomial hashes (mod 2^64) of the current overlap length L
+    uint64_t start_pfx;   // префикс start длины L
+    uint64_t rcend_pfx;   // префикс rcend длины L
+    uint64_t end_sfx;     // суффикс end длины L
+    uint64_t rcstart_sfx; // суффикс rcstart длины L
+};
+
+OverlapCollection detect_adjacent_contigs_indexed(const ContigCollection& contig_collection,
+                                                  int mink, int maxk) {
+    // Index-based search with the same result as `detect_adjacent_contigs_pairwise`.
+    // For every overlap length L = mink..maxk the L-long prefixes and suffixes of all termini
+    // are fingerprinted and sorted, and each contig looks up only the termini that match it.
+    // Shared prefixes/suffixes (cases 4-7) are monotone in L, so they are looked up once
+    // at L = mink and extended by direct comparison.
+    // Runs in about O(n * (maxk - mink) * log n + number of overlaps).
+    // Overlaps are at least 1 bp long: `mink <= 0` is searched from L = 1, as the all-pairs
+    // search does, so both engines agree for any `mink`.
+    int num_contigs = contig_collection.size();
+    const int min_len = std::max(mink, 1);
+
+    // Terminus strings, restored from the packed termini for the duration of the search
+    const TerminusStrings strings(contig_collection);
+    auto terminus_len = [&](ContigIndex c) {
+        return static_cast<int>(strings.start(c).length());
+    };
+    auto start_pfx = [&](ContigIndex c, int len) { return strings.start(c).substr(0, len); };
+    auto rcend_pfx = [&](ContigIndex c, int len) { return strings.rcend(c).substr(0, len); };
+    auto end_sfx = [&](ContigIndex c, int len) {
+        std::string_view end = strings.end(c);
+        return end.substr(end.length() - len);
+    };
+    auto rcstart_sfx = [&](ContigIndex c, int len) {
+        std::string_view rcstart = strings.rcstart(c);
+        return rcstart.substr(rcstart.length() - len);
+    };
+    // Longest common prefix (or suffix) of two views, not longer than `limit`
+    auto common_prefix = [](std::string_view a, std::string_view b, int limit) {
+        int len = 0;
+        while (len < limit && a[len] == b[len]) len++;
+        return len;
+    };
+    auto common_suffix = [](std::string_view a, std::string_view b, int limit) {
+        int len = 0;
+        while (len < limit && a[a.length() - 1 - len] == b[b.length() - 1 - len]) len++;
+        return len;
+    };
+
+    struct Hit {
+        ContigIndex j;
+        int pair_case;
+        int ovl_len;
+        bool operator<(const Hit& other) const {
+            // by j, then by case, the longest overlap first
+            if (j != other.j) return j < other.j;
+            if (pair_case != other.pair_case) return pair_case < other.pair_case;
+            return ovl_len > other.ovl_len;
+        }
+    };
+    std::vector<std::vector<Hit>> row_hits(num_contigs);
+    std::vector<int> self_e2s(num_contigs, 0);
+
+    typedef std::vector<std::pair<uint64_t, ContigIndex>> FingerprintIndex;
+    FingerprintIndex start_index, end_index, rcstart_index, rcend_index;
+    std::vector<_TerminusHashState> hashes(num_contigs, _TerminusHashState{0, 0, 0, 0});
+    std::vector<ContigIndex> active; // contigs with termini of at least L bp
+
+    for (ContigIndex c = 0; c < num_contigs; ++c) {
+        active.push_back(c);
+    }
+
+    uint64_t base_pow = 1; // TERMINUS_HASH_BASE^(L - 1)
+    for (int len = 1; len <= maxk; ++len) {
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [&](ContigIndex c) { return terminus_len(c) < len; }),
+                     active.end());
+        if (active.empty()) {
+            break;
+        }
+
+        // Extend fingerprints from L - 1 to L
+        #pragma omp parallel for
+        for (size_t a = 0; a < active.size(); ++a) {
+            ContigIndex c = active[a];
+            _TerminusHashState& h = hashes[c];
+            h.start_pfx = h.start_pfx * TERMINUS_HASH_BASE + static_cast<unsigned char>(start_pfx(c, len).back());
+            h.rcend_pfx = h.rcend_pfx * TERMINUS_HASH_BASE + static_cast<unsigned char>(rcend_pfx(c, len).back());
+            h.end_sfx += static_cast<unsigned char>(end_sfx(c, len).front()) * base_pow;
+            h.rcstart_sfx += static_cast<unsigned char>(rcstart_sfx(c, len).front()) * base_pow;
+        }
+        base_pow *= TERMINUS_HASH_BASE;
+
+        if (len < min_len) {
+            continue;
+        }
+        std::cout << "\r" << len << "/" << maxk;
+
+        // Sorted (fingerprint, contig) arrays; contigs are ascending inside equal fingerprints
+        FingerprintIndex* indices[4] = {&start_index, &end_index, &rcstart_index, &rcend_index};
+        #pragma omp parallel for
+        for (int kind = 0; kind < 4; ++kind) {
+            FingerprintIndex& index = *indices[kind];
+            index.clear();
+            for (ContigIndex c : active) {
+                const _TerminusHashState& h = hashes[c];
+                uint64_t key = kind == 0 ? h.start_pfx : kind == 1 ? h.end_sfx : kind == 2 ? h.rcstart_sfx : h.rcend_pfx;
+                index.emplace_back(key, c);
             }
-            if (overlaps[5] != 0) {
-                local_overlaps.emplace_back(i, END, j, END, overlaps[5]);
-                local_overlaps.emplace_back(j, END, i, END, overlaps[5]);
+            std::sort(index.begin(), index.end());
+        }
+
+        // For every orientation case: the index to look up and the fingerprint of i
+        // (the same checks as in `detect_adjacent_contigs_pairwise`)
+        const FingerprintIndex* case_index[8] = {
+            &end_index, &start_index, &rcstart_index, &rcend_index,
+            &start_index, &end_index, &rcend_index, &rcstart_index
+        };
+        const bool case_uses_start[8] = {true, false, true, false, true, false, true, false};
+        // Cases 4-7 are checked only once, at the shortest length
+        const int num_cases = len == min_len ? 8 : 4;
+
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (size_t a = 0; a < active.size(); ++a) {
+            ContigIndex i = active[a];
+            if (contig_collection[i].length <= mink) {
+                continue;
             }
-            if (overlaps[6] != 0) {
-                local_overlaps.emplace_back(i, START, j, RCEND, overlaps[6]);
-                local_overlaps.emplace_back(j, RCEND, i, START, overlaps[6]);
+            const _TerminusHashState& hi = hashes[i];
+
+            // Self-overlap of the end with the start (the longest one wins)
+            if (hi.end_sfx == hi.start_pfx && end_sfx(i, len) == start_pfx(i, len)) {
+                self_e2s[i] = len;
             }
-            if (overlaps[7] != 0) {
-                local_overlaps.emplace_back(i, END, j, RCSTART, overlaps[7]);
-                local_overlaps.emplace_back(j, RCSTART, i, END, overlaps[7]);
+
+            for (int c = 0; c < num_cases; ++c) {
+                uint64_t key = case_uses_start[c] ? hi.start_pfx : hi.end_sfx;
+                const FingerprintIndex& index = *case_index[c];
+                auto it = std::upper_bound(index.begin(), index.end(), std::make_pair(key, i));
+                for (; it != index.end() && it->first == key; ++it) {
+                    ContigIndex j = it->second;
+                    int ovl_len = len;
+                    bool is_match;
+                    switch (c) {
+                        case 0: is_match = end_sfx(j, len) == start_pfx(i, len); break;
+                        case 1: is_match = end_sfx(i, len) == start_pfx(j, len); break;
+                        case 2: is_match = rcstart_sfx(j, len) == start_pfx(i, len); break;
+                        case 3: is_match = end_sfx(i, len) == rcend_pfx(j, len); break;
+                        default: {
+                            // Shared prefix/suffix: extend to the longest one directly
+                            int limit = std::min(maxk, std::min(terminus_len(i), terminus_len(j)));
+                            if (c == 4) ovl_len = common_prefix(strings.start(i), strings.start(j), limit);
+                            if (c == 5) ovl_len = common_suffix(strings.end(i), strings.end(j), limit);
+                            if (c == 6) ovl_len = common_prefix(strings.start(i), strings.rcend(j), limit);
+                            if (c == 7) ovl_len = common_suffix(strings.end(i), strings.rcstart(j), limit);
+                            is_match = ovl_len >= min_len;
+                        }
+                    }
+                    if (is_match) {
+                        row_hits[i].push_back(Hit{j, c, ovl_len});
+                    }
+                }
             }
         }
+    }
+    std::cout << std::endl;
 
-        // Critical section to add local overlaps to the shared collection
-        #pragma omp critical
-        {
-            for (const auto& ovl : local_overlaps) {
-                overlap_collection.add_overlap(ovl.contig_i, ovl);
-            }
+    // Emit overlaps of every row into its own buffer
+    std::vector<std::vector<Overlap>> row_overlaps(num_contigs);
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (ContigIndex i = 0; i < num_contigs; ++i) {
+        if (contig_collection[i].length <= mink) {
+            continue;
+        }
+        std::vector<Overlap>& local_overlaps = row_overlaps[i];
+        // A contig whose whole sequence "overlaps" itself is not circular
+        if (self_e2s[i] > 0 && self_e2s[i] < contig_collection[i].length) {
+            local_overlaps.emplace_back(i, END, i, START, self_e2s[i]);
+        }
+        int limit = std::min(maxk, terminus_len(i));
+        int self_s2s = common_prefix(strings.start(i), strings.rcend(i), limit);
+        if (self_s2s >= min_len) {
+            local_overlaps.emplace_back(i, START, i, RCEND, self_s2s);
         }
 
-        std::cout << "\r" << i + 1 << "/" << num_contigs;
+        std::vector<Hit>& hits = row_hits[i];
+        std::sort(hits.begin(), hits.end());
+        for (size_t h = 0; h < hits.size(); ++h) {
+            // Only the longest overlap of each (j, case) is kept
+            if (h > 0 && hits[h].j == hits[h - 1].j && hits[h].pair_case == hits[h - 1].pair_case) {
+                continue;
+            }
+            _add_pair_overlaps(local_overlaps, i, hits[h].j, hits[h].pair_case, hits[h].ovl_len);
+        }
+        std::vector<Hit>().swap(hits);
     }
+    return OverlapCollection(num_contigs, row_overlaps);
+}
 
-    std::cout << std::endl;
-    return overlap_collection;
-} 
\ No newline at end of file
+bool _prefer_pairwise_search(int num_contigs, int mink, int maxk) {
+    // Rough cost model: the all-pairs search checks n^2 / 2 pairs, the indexed one
+    // sorts n fingerprints four times for each overlap length.
+    double n = num_contigs;
+    double pairwise_cost = 4.0 * n * n;
+    double indexed_cost = 16.0 * n * std::max(1, maxk - mink + 1) * std::log2(n + 2);
+    return pairwise_cost < indexed_cost;
+}
+
+OverlapCollection detect_adjacent_contigs(const ContigCollection& contig_collection,
+                                          int mink, int maxk,
+                                          std::vector<SearchThreadStats>* thread_stats = nullptr) {
+    // Function finds all overlaps of `mink`..`maxk` bp between contig termini.
+    // The indexed search is used unless the collection is small enough
+    // for the all-pairs search to be cheaper; both give the same result
+    // (for `mink <= 0` too: overlaps are searched from 1 bp).
+    // `thread_stats` is filled by the all-pairs search only (and left empty otherwise).
+    if (thread_stats != nullptr) {
+        thread_stats->clear();
+    }
+    if (_prefer_pairwise_search(contig_collection.size(), mink, maxk)) {
+        return detect_adjacent_contigs_pairwise(contig_collection, mink, maxk, thread_stats);
+    }
+    return detect_adjacent_contigs_indexed(contig_collection, mink, maxk);
+}
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "sequence_kernels.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+// 2-bit packed canonical contig termini.
+// Both ends of a contig are stored read inward, in the orientation that starts at that end:
+// strand 0 is `start`, strand 1 is `rcend` (the end read from the last base backwards).
+// `end` and `rcstart` are their reverse complements and are never stored.
+// Base t of a terminus is stored in word t / 32 at bits 2 * (t % 32): A=0, C=1, G=2, T=3,
+// so the complement of a base is its code XOR 3.
+// Flags word t / 32 holds the mask bit of the base at bit t % 32 (the base is not A/C/G/T
+// in either case) and its lowercase bit at bit 32 + t % 32 (lowercase a/c/g/t).
+// A masked base is packed as A; its character as it is in the contig (of `start`, or of
+// `end` for strand 1) is kept in a side string, in the order of the masked bases.
+// Comparisons use the words, and the characters only for 32-base blocks with masked bases,
+// so the results are the same as of the comparisons of the terminus strings.
+
+int _ctz64(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+int _popcount64(uint64_t x) {
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(x));
+#else
+    return __builtin_popcountll(x);
+#endif
+}
+
+uint64_t _reverse_bases(uint64_t x) {
+    // Function reverses the order of the 32 2-bit bases of a word.
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+#ifdef _MSC_VER
+    return _byteswap_uint64(x);
+#else
+    return __builtin_bswap64(x);
+#endif
+}
+
+uint32_t _reverse_bits32(uint32_t x) {
+    x = ((x >> 1) & 0x55555555U) | ((x & 0x55555555U) << 1);
+    x = ((x >> 2) & 0x33333333U) | ((x & 0x33333333U) << 2);
+    x = ((x >> 4) & 0x0F0F0F0FU) | ((x & 0x0F0F0F0FU) << 4);
+    x = ((x >> 8) & 0x00FF00FFU) | ((x & 0x00FF00FFU) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+uint64_t _spread_bits(uint32_t bits) {
+    // Function moves bit i of `bits` to bit 2 * i, the low bit of the i-th 2-bit base
+    uint64_t x = bits;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | (x << 2)) & 0x3333333333333333ULL;
+    x = (x | (x << 1)) & 0x5555555555555555ULL;
+    return x;
+}
+
+const int STRAND_FORWARD = 0;  // start
+const int STRAND_REVERSE = 1;  // rcend
+
+struct PackedTerminus {
+    const uint64_t* bases;      // 2 бита на основание
+    const uint64_t* flags;      // биты маски и нижнего регистра (nullptr, если их нет во всей таблице)
+    const char* masked_chars;   // символы замаскированных оснований строки
+    int length;                 // длина термина в bp
+    int first_masked;           // позиция первого основания не из A/C/G/T (или length)
+    int strand;                 // STRAND_FORWARD или STRAND_REVERSE
+};
+
+uint64_t _packed_bases(const PackedTerminus& t, int offset, int count) {
+    // Function returns `count` (1..32) bases starting at `offset` in the low 2 * count bits.
+    // Packed rows carry one spare zero word, so reading `word + 1` is always safe.
+    int word = offset / 32;
+    int shift = 2 * (offset % 32);
+    uint64_t bits = t.bases[word] >> shift;
+    if (shift != 0) {
+        bits |= t.bases[word + 1] << (64 - shift);
+    }
+    return count == 32 ? bits : bits & ((uint64_t(1) << (2 * count)) - 1);
+}
+
+uint32_t _packed_flags(const PackedTerminus& t, int offset, int count, int half) {
+    // Function returns the mask (`half` 0) or lowercase (`half` 1) bits of `count` (1..32)
+    // bases starting at `offset`, in the low `count` bits.
+    if (t.flags == nullptr) {
+        return 0;
+    }
+    int word = offset / 32;
+    int shift = offset % 32;
+    uint64_t bits = (t.flags[word] >> (32 * half)) & 0xFFFFFFFFULL;
+    if (shift != 0) {
+        bits = (bits >> shift) | (((t.flags[word + 1] >> (32 * half)) & 0xFFFFFFFFULL) << (32 - shift));
+    }
+    return static_cast<uint32_t>(count == 32 ? bits : bits & ((uint64_t(1) << count) - 1));
+}
+
+char _source_char(const PackedTerminus& t, int k) {
+    // Function returns the character of base k as it is in the contig:
+    // of `start` for strand 0, of `end` (read backwards) for strand 1
+    static const char BASES[4] = {'A', 'C', 'G', 'T'};
+    uint64_t flags = t.flags == nullptr ? 0 : t.flags[k / 32];
+    uint64_t bit = uint64_t(1) << (k % 32);
+    if (flags & bit) {
+        size_t rank = _popcount64(flags & (bit - 1) & 0xFFFFFFFFULL);
+        for (int w = 0; w < k / 32; ++w) {
+            rank += _popcount64(t.flags[w] & 0xFFFFFFFFULL);
+        }
+        return t.masked_chars[rank];
+    }
+    int code = static_cast<int>((t.bases[k / 32] >> (2 * (k % 32))) & 3);
+    if (t.strand == STRAND_REVERSE) {
+        code ^= 3;
+    }
+    char base = BASES[code];
+    return (flags & (bit << 32)) ? static_cast<char>(base | 0x20) : base;
+}
+
+char _char_in_frame(const PackedTerminus& t, int k, int frame) {
+    // Function returns base k of `t` as a character of the terminus strings: in frame 0
+    // of `start` or `rcend` (prefix read inward), in frame 1 of `end` or `rcstart`
+    // (suffix read backwards). Strings of the other strand are the complemented ones.
+    char base = _source_char(t, k);
+    return t.strand == frame ? base : _COMPL_TABLE[static_cast<unsigned char>(base)];
+}
+
+bool _has_masked(const PackedTerminus& a, const PackedTerminus& b, int offset_a, int offset_b, int count) {
+    if (offset_a + count <= a.first_masked && offset_b + count <= b.first_masked) {
+        return false;
+    }
+    return (_packed_flags(a, offset_a, count, 0) | _packed_flags(b, offset_b, count, 0)) != 0;
+}
+
+int packed_common_prefix(const PackedTerminus& a, const PackedTerminus& b, int limit) {
+    // Function returns the length of the common prefix of `a` and `b`, at most `limit`,
+    // comparing 32 bases per XOR. Both are compared in the frame of `a`: as `start`/`rcend`
+    // for strand 0 of `a` (s2s cases), as `end`/`rcstart` for strand 1 (e2e cases).
+    for (int k = 0; k < limit; k += 32) {
+        int count = std::min(32, limit - k);
+        if (_has_masked(a, b, k, k, count)) {
+            for (int t = k; t < k + count; ++t) {
+                if (_char_in_frame(a, t, a.strand) != _char_in_frame(b, t, a.strand)) {
+                    return t;
+                }
+            }
+            continue;
+        }
+        uint64_t diff = (_packed_bases(a, k, count) ^ _packed_bases(b, k, count)) |
+                        _spread_bits(_packed_flags(a, k, count, 1) ^ _packed_flags(b, k, count, 1));
+        if (diff != 0) {
+            return k + _ctz64(diff) / 2;
+        }
+    }
+    return limit;
+}
+
+bool packed_rc_equal(const PackedTerminus& a, const PackedTerminus& b, int len) {
+    // Function returns true if the `len`-long prefix of `a` is the reverse complement
+    // of the `len`-long prefix of `b`, i.e. the two ends join head to head (e2s cases):
+    // `a` is compared as `start`/`rcend`, `b` as the suffix of `end`/`rcstart`.
+    for (int k = 0; k < len; k += 32) {
+        int count = std::min(32, len - k);
+        int offset_b = len - k - count;
+        if (_has_masked(a, b, k, offset_b, count)) {
+            for (int t = k; t < k + count; ++t) {
+                if (_char_in_frame(a, t, 0) != _char_in_frame(b, len - 1 - t, 1)) {
+                    return false;
+                }
+            }
+            continue;
+        }
+        uint64_t mask = count == 32 ? ~uint64_t(0) : (uint64_t(1) << (2 * count)) - 1;
+        uint64_t rc = (_reverse_bases(_packed_bases(b, offset_b, count)) >> (64 - 2 * count)) ^ mask;
+        uint32_t rc_lower = _reverse_bits32(_packed_flags(b, offset_b, count, 1)) >> (32 - count);
+        if (_packed_bases(a, k, count) != rc || _packed_flags(a, k, count, 1) != rc_lower) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void unpack_terminus(const PackedTerminus& t, std::string& seq) {
+    // Function writes the characters of a terminus as they are in the contig, read inward:
+    // `start` for strand 0, `end` from its last base for strand 1.
+    // The capacity of `seq` is reused.
+    seq.resize(t.length);
+    for (int k = 0; k < t.length; ++k) {
+        seq[k] = _source_char(t, k);
+    }
+}
+
+class PackedTermini {
+public:
+    // Конструктор класса PackedTermini. Хранит два канонических термина каждого контига
+    // (start и rcend) в одном непрерывном массиве слов, по строке на термин.
+    // Rows are `ceil(max terminus length / 32)` words; one spare zero word at the end
+    // of the array keeps `_packed_bases` within it for the last row. The flags array
+    // has the same layout and is allocated with the first masked or lowercase base.
+    PackedTermini() : _base_words(0), _bases(1, 0), _capacity(0) {}
+
+    // Число контигов
+    size_t size() const { return _rows.size() / 2; }
+
+    void reserve(size_t num_contigs) {
+        // Word arrays are reserved again when the row width becomes known (`_relayout`)
+        _capacity = std::max(_capacity, num_contigs);
+        _rows.reserve(2 * num_contigs);
+        _bases.reserve(2 * num_contigs * _base_words + 1);
+    }
+
+    // Метод добавляет термины очередного контига: `start` и `end` (хранится как rcend)
+    void push_back(std::string_view start, std::string_view end) {
+        size_t base_words = (std::max(start.length(), end.length()) + 31) / 32;
+        if (base_words > _base_words) {
+            _relayout(base_words);
+        }
+        _bases.resize(_bases.size() + 2 * _base_words, 0);
+        if (!_flags.empty()) {
+            _flags.resize(_bases.size(), 0);
+        }
+        _pack(_rows.size(), start, STRAND_FORWARD);
+        _pack(_rows.size(), end, STRAND_REVERSE);
+    }
+
+    // Метод добавляет в конец термины всех контигов `other`
+    void append(const PackedTermini& other) {
+        if (other._base_words > _base_words) {
+            _relayout(other._base_words);
+        }
+        if (_flags.empty() && !other._flags.empty()) {
+            _flags.assign(_bases.size(), 0);
+        }
+        size_t first_row = _rows.size();
+        _bases.resize(_bases.size() + other._rows.size() * _base_words, 0);
+        if (!_flags.empty()) {
+            _flags.resize(_bases.size(), 0);
+        }
+        for (size_t row = 0; row < other._rows.size(); ++row) {
+            size_t from = row * other._base_words;
+            size_t to = (first_row + row) * _base_words;
+            std::copy(other._bases.begin() + from, other._bases.begin() + from + other._base_words,
+                      _bases.begin() + to);
+            if (!other._flags.empty()) {
+                std::copy(other._flags.begin() + from, other._flags.begin() + from + other._base_words,
+                          _flags.begin() + to);
+            }
+            _Row info = other._rows[row];
+            info.masked_chars += _masked_chars.size();
+            _rows.push_back(info);
+        }
+        _masked_chars.append(other._masked_chars);
+    }
+
+    // Термин контига `c`, прочитанный от его конца `strand` внутрь
+    PackedTerminus inward(size_t c, int strand) const {
+        size_t row = 2 * c + strand;
+        const _Row& info = _rows[row];
+        return PackedTerminus{_bases.data() + row * _base_words,
+                              _flags.empty() ? nullptr : _flags.data() + row * _base_words,
+                              _masked_chars.data() + info.masked_chars,
+                              info.length, info.first_masked, strand};
+    }
+
+private:
+    struct _Row {
+        int length;           // длина термина в bp
+        int first_masked;     // позиция первого основания не из A/C/G/T (или length)
+        size_t masked_chars;  // начало символов замаскированных оснований в `_masked_chars`
+    };
+
+    size_t _base_words;           // слов на строку
+    std::vector<uint64_t> _bases; // строки по `_base_words` слов и одно запасное слово
+    std::vector<uint64_t> _flags; // та же раскладка, что у `_bases`, или пусто
+    std::string _masked_chars;
+    std::vector<_Row> _rows;
+    size_t _capacity;             // число контигов из `reserve`
+
+    void _pack(size_t row, std::string_view seq, int strand) {
+        // Strand 1 is `end`, packed from its last base backwards as the codes of `rcend`
+        size_t len = seq.length();
+        uint64_t* bases = _bases.data() + row * _base_words;
+        int first_masked = static_cast<int>(len);
+        size_t masked_chars = _masked_chars.size();
+        for (size_t t = 0; t < len; ++t) {
+            char base = strand == STRAND_FORWARD ? seq[t] : seq[len - 1 - t];
+            uint64_t code = 0;
+            uint64_t flag = 0;
+            switch (base) {
+                case 'A': code = 0; break;
+                case 'C': code = 1; break;
+                case 'G': code = 2; break;
+                case 'T': code = 3; break;
+                case 'a': code = 0; flag = uint64_t(1) << 32; break;
+                case 'c': code = 1; flag = uint64_t(1) << 32; break;
+                case 'g': code = 2; flag = uint64_t(1) << 32; break;
+                case 't': code = 3; flag = uint64_t(1) << 32; break;
+                default:
+                    flag = 1;
+                    first_masked = std::min(first_masked, static_cast<int>(t));
+                    _masked_chars.push_back(base);
+            }
+            if (strand == STRAND_REVERSE && flag != 1) {
+                code ^= 3;
+            }
+            bases[t / 32] |= code << (2 * (t % 32));
+            if (flag != 0) {
+                if (_flags.empty()) {
+                    _flags.assign(_bases.size(), 0);
+                }
+                _flags[row * _base_words + t / 32] |= flag << (t % 32);
+            }
+        }
+        _rows.push_back(_Row{static_cast<int>(len), first_masked, masked_chars});
+    }
+
+    void _relayout(size_t base_words) {
+        // Loaders push termini of one length, so this runs once per table
+        std::vector<uint64_t> bases;
+        bases.reserve(std::max(_rows.size(), 2 * _capacity) * base_words + 1);
+        bases.resize(_rows.size() * base_words + 1, 0);
+        std::vector<uint64_t> flags(_flags.empty() ? 0 : bases.size(), 0);
+        for (size_t row = 0; row < _rows.size(); ++row) {
+            std::copy(_bases.begin() + row * _base_words, _bases.begin() + (row + 1) * _base_words,
+                      bases.begin() + row * base_words);
+            if (!flags.empty()) {
+                std::copy(_flags.begin() + row * _base_words, _flags.begin() + (row + 1) * _base_words,
+                          flags.begin() + row * base_words);
+            }
+        }
+        _bases.swap(bases);
+        _flags.swap(flags);
+        _base_words = base_words;
+    }
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+using namespace std;
+
+// KLL quantile sketch (Karnin, Lang, Liberty, 2016) over floats.
+// Values are kept in a stack of compactors; an item at level h stands for 2^h values.
+// A full compactor is sorted and every other item (odd or even positions, chosen at random)
+// is promoted to the next level, so memory is O(k) whatever the number of values.
+// The rank error of a quantile shrinks as 1 / k: about 1.65% of the number of values for k = 200.
+// Sketches of parts of a stream can be merged. Until the first compaction the sketch
+// holds all values and quantiles are exact.
+
+const int KLL_DEFAULT_K = 200;
+
+class KllSketch {
+public:
+    // Конструктор класса KllSketch; `k` задаёт точность (и размер) скетча
+    explicit KllSketch(int k = KLL_DEFAULT_K) : _k(k), _num_values(0), _num_items(0), _max_items(0), _rng(0x9e3779b97f4a7c15ULL) {
+        _grow();
+    }
+
+    void add(float value) {
+        _levels[0].push_back(value);
+        _num_values++;
+        _num_items++;
+        if (_num_items >= _max_items) {
+            _compress();
+        }
+    }
+
+    void merge(const KllSketch& other) {
+        while (_levels.size() < other._levels.size()) {
+            _grow();
+        }
+        for (size_t h = 0; h < other._levels.size(); ++h) {
+            _levels[h].insert(_levels[h].end(), other._levels[h].begin(), other._levels[h].end());
+        }
+        _num_values += other._num_values;
+        _num_items += other._num_items;
+        while (_num_items >= _max_items) {
+            _compress();
+        }
+    }
+
+    // Number of values added (to this sketch and the merged ones)
+    uint64_t size() const { return _num_values; }
+    bool empty() const { return _num_values == 0; }
+
+    // True while no value has been discarded
+    bool is_exact() const { return _levels.size() == 1; }
+
+    // All values, if the sketch is exact
+    const std::vector<float>& values() const { return _levels[0]; }
+
+    float quantile(double q) const {
+        // Function returns the value of (approximate) rank q * size(), q in [0, 1]:
+        // the smallest value whose cumulative weight reaches it.
+        std::vector<std::pair<float, uint64_t>> items;
+        items.reserve(_num_items);
+        for (size_t h = 0; h < _levels.size(); ++h) {
+            for (float value : _levels[h]) {
+                items.emplace_back(value, uint64_t(1) << h);
+            }
+        }
+        if (items.empty()) {
+            return std::numeric_limits<float>::quiet_NaN();
+        }
+        std::sort(items.begin(), items.end());
+
+        uint64_t total_weight = 0;
+        for (const auto& item : items) {
+            total_weight += item.second;
+        }
+        double target = std::min(std::max(q, 0.0), 1.0) * total_weight;
+        uint64_t weight = 0;
+        for (const auto& item : items) {
+            weight += item.second;
+            if (weight >= target) {
+                return item.first;
+            }
+        }
+        return items.back().first;
+    }
+
+private:
+    int _k;
+    uint64_t _num_values;
+    size_t _num_items;  // items kept in all levels
+    size_t _max_items;  // total capacity of the levels
+    uint64_t _rng;
+    std::vector<std::vector<float>> _levels;
+
+    size_t _capacity(size_t level) const {
+        // Capacities shrink by 2/3 from the top level down
+        size_t depth = _levels.size() - level - 1;
+        return static_cast<size_t>(std::ceil(std::pow(2.0 / 3.0, depth) * _k)) + 1;
+    }
+
+    void _grow() {
+        _levels.emplace_back();
+        _max_items = 0;
+        for (size_t h = 0; h < _levels.size(); ++h) {
+            _max_items += _capacity(h);
+        }
+    }
+
+    bool _coin() {
+        // xorshift64: compaction offsets are random but reproducible
+        _rng ^= _rng << 13;
+        _rng ^= _rng >> 7;
+        _rng ^= _rng << 17;
+        return _rng & 1;
+    }
+
+    void _compress() {
+        for (size_t h = 0; h < _levels.size(); ++h) {
+            if (_levels[h].size() < _capacity(h)) {
+                continue;
+            }
+            if (h + 1 == _levels.size()) {
+                _grow();
+            }
+            std::vector<float>& level = _levels[h];
+            std::sort(level.begin(), level.end());
+            // An odd item out stays at this level
+            size_t num_pairs = level.size() / 2;
+            size_t first = level.size() - 2 * num_pairs;
+            size_t offset = _coin();
+            for (size_t p = 0; p < num_pairs; ++p) {
+                _levels[h + 1].push_back(level[first + 2 * p + offset]);
+            }
+            level.resize(first);
+            _num_items -= num_pairs;
+            if (_num_items < _max_items) {
+                break;
+            }
+        }
+    }
+};
@@ -7,12 +7,42 @@
 #include "overlaps.hpp"
 #include "assign_multiplicity.hpp"
 #include "output.hpp"
+#include "assembly_graph.hpp"
 
 using namespace Rcpp;
 
+List assembly_stats_to_list(const AssemblyStats& stats) {
+    // 64-bit counts are returned as doubles (R has no 64-bit integers)
+    return List::create(
+        Named("num_contigs") = static_cast<double>(stats.num_contigs),
+        Named("total_length") = static_cast<double>(stats.total_length),
+        Named("expected_genome_size") = static_cast<double>(stats.expected_genome_size),
+        Named("n50") = stats.n50,
+        Named("l50") = static_cast<double>(stats.l50),
+        Named("ng50") = stats.ng50,
+        Named("lg50") = static_cast<double>(stats.lg50),
+        Named("aun") = stats.aun,
+        Named("min_coverage") = stats.min_coverage,
+        Named("max_coverage") = stats.max_coverage,
+        Named("mean_coverage") = stats.mean_coverage,
+        Named("median_coverage") = stats.median_coverage,
+        Named("p5_coverage") = stats.p5_coverage,
+        Named("p95_coverage") = stats.p95_coverage,
+        Named("num_dead_ends") = static_cast<double>(stats.num_dead_ends),
+        Named("lq_coef") = stats.lq_coef
+    );
+}
+
 // [[Rcpp::export]]
 List analyze_contigs_cpp(std::string filepath, int maxk, int mink, 
-                         std::string output_dir, int num_iterations) {
+                         std::string output_dir, int num_iterations,
+                         bool verify_graph = false, int exact_k = 0) {
+
+    // GFA/FASTG input already carries contig adjacencies, overlap detection is skipped.
+    // For FASTG the overlap length is the assembly k, taken from `maxk`.
+    const bool is_graph = is_assembly_graph(filepath);
+    // exact_k > 0: de Bruijn assembly, only overlaps of exactly `exact_k` bp are searched
+    const int terminus_len = std::max(maxk, exact_k);
 
     std::filesystem::path output_path(output_dir);
     if (!std::filesystem::exists(output_path)) {
@@ -28,6 +58,8 @@ List analyze_contigs_cpp(std::string filepath, int maxk, int mink,
     std::vector<long> multiplicity_assignment_times;
     std::vector<long> file_writing_times;
     std::vector<long> total_times;
+    AssemblyStats assembly_stats;
+    std::vector<SearchThreadStats> thread_stats;
 
     for (int iteration = 0; iteration < num_iterations; ++iteration) {
         Rcout << "\nStarting iteration " << iteration + 1 << " of " << num_iterations << std::endl;
@@ -36,13 +68,25 @@ List analyze_contigs_cpp(std::string filepath, int maxk, int mink,
 
         // Contig Collection
         auto start_time = std::chrono::high_resolution_clock::now();
-        ContigCollection contig_collection = get_contig_collection(filepath, maxk);
+        ContigCollection contig_collection;
+        OverlapCollection overlap_collection;
+        if (is_graph) {
+            load_assembly_graph(filepath, maxk, maxk, contig_collection, overlap_collection);
+        } else {
+            contig_collection = get_contig_collection(filepath, terminus_len);
+        }
         auto end_time = std::chrono::high_resolution_clock::now();
         long contig_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
 
         // Overlap Detection
         start_time = std::chrono::high_resolution_clock::now();
-        OverlapCollection overlap_collection = detect_adjacent_contigs(contig_collection, mink, maxk);
+        if (!is_graph) {
+            overlap_collection = exact_k > 0
+                ? detect_adjacent_contigs_exact_k(contig_collection, exact_k)
+                : detect_adjacent_contigs(contig_collection, mink, maxk, &thread_stats);
+        } else if (verify_graph) {
+            verify_graph_overlaps(contig_collection, overlap_collection);
+        }
         end_time = std::chrono::high_resolution_clock::now();
         long overlap_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
 
@@ -60,9 +104,8 @@ List analyze_contigs_cpp(std::string filepath, int maxk, int mink,
         }
         std::string outdpath = iteration_dir.string();
 
-        write_summary(contig_collection, overlap_collection, filepath, outdpath);
-        write_adjacency_table_and_full_log(contig_collection, overlap_collection, outdpath);
-        write_genbank(contig_collection, overlap_collection, outdpath);
+        assembly_stats = calc_assembly_stats(contig_collection, overlap_collection);
+        write_outputs(contig_collection, overlap_collection, assembly_stats, filepath, outdpath);
         end_time = std::chrono::high_resolution_clock::now();
         long file_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
 
@@ -109,8 +152,27 @@ List analyze_contigs_cpp(std::string filepath, int maxk, int mink,
                << "  Total Time: " << avg_total << " ms\n";
     stats_file.close();
 
+    // Load balance of the all-pairs search in the last iteration (empty for the other searches)
+    IntegerVector thread_numbers = seq_len(thread_stats.size()) - 1;
+    std::vector<double> busy_seconds, own_tiles, stolen_tiles;
+    for (const SearchThreadStats& stats : thread_stats) {
+        busy_seconds.push_back(stats.busy_seconds);
+        own_tiles.push_back(static_cast<double>(stats.own_tiles));
+        stolen_tiles.push_back(static_cast<double>(stats.stolen_tiles));
+    }
+
     return List::create(
         Named("adjacency_table_path") = (output_path / "iteration_1__adjacent_contigs.tsv").string(),
+        Named("gfa_path") = (output_path / "iteration_1_overlap_graph.gfa").string(),
+        Named("contigs_table_path") = (output_path / "iteration_1_contigs.bin").string(),
+        Named("overlaps_table_path") = (output_path / "iteration_1_overlaps.bin").string(),
+        Named("assembly_stats") = assembly_stats_to_list(assembly_stats),
+        Named("thread_stats") = DataFrame::create(
+            Named("thread") = thread_numbers,
+            Named("busy_seconds") = busy_seconds,
+            Named("own_tiles") = own_tiles,
+            Named("stolen_tiles") = stolen_tiles
+        ),
         Named("execution_times") = DataFrame::create(
             Named("iteration") = seq_len(num_iterations),
             Named("contig_collection") = contig_collection_times,
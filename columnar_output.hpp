@@ -0,0 +1,253 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+
+#include "contigs.hpp"
+#include "overlaps.hpp"
+#include "output_buffer.hpp"
+
+using namespace std;
+
+// Columnar binary tables for fast loading in R (`read_contig_tables` in ContigR):
+// one table of contig attributes and one flat table of overlap records.
+// The layout is self-describing (all numbers little-endian):
+//
+//   magic "CTGTABL1"                                      8 bytes
+//   uint32 version, uint32 number of columns              8 bytes
+//   int64 number of rows                                  8 bytes
+//   column directory, COLUMN_ENTRY_SIZE bytes per column:
+//     char name[COLUMN_NAME_SIZE] (NUL-padded), uint32 type, uint32 reserved,
+//     int64 offset of the column from the start of the file, int64 column size in bytes
+//   column buffers, each starting at a multiple of 8 bytes
+//
+// Fixed-width columns are plain arrays and string columns are NUL-terminated strings,
+// one after another, so the reader seeks to the offset of a column and reads it from the file
+// in one `readBin` call, without loading the whole file.
+// Contig columns are written straight from the vectors of `ContigCollection`, without copies.
+
+const char COLUMNAR_MAGIC[8] = {'C', 'T', 'G', 'T', 'A', 'B', 'L', '1'};
+const uint32_t COLUMNAR_VERSION = 1;
+const size_t COLUMN_NAME_SIZE = 24;
+const size_t COLUMN_ENTRY_SIZE = COLUMN_NAME_SIZE + 24;
+const size_t COLUMN_ALIGNMENT = 8;
+
+enum ColumnType : uint32_t {
+    COLUMN_INT32 = 1,
+    COLUMN_FLOAT32 = 2,
+    COLUMN_UINT8 = 3,
+    COLUMN_STRING = 4
+};
+
+static_assert(sizeof(int) == 4 && sizeof(float) == 4, "Columns of type int32/float32 are written from int/float vectors");
+
+struct _ColumnSpec {
+    const char* name;
+    ColumnType type;
+    uint64_t byte_len;
+};
+
+uint64_t _aligned_column_len(uint64_t byte_len) {
+    return (byte_len + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+}
+
+void _write_le(OutputBuffer& out, uint64_t value, size_t num_bytes) {
+    // Little-endian whatever the host byte order
+    char bytes[8];
+    for (size_t b = 0; b < num_bytes; ++b) {
+        bytes[b] = static_cast<char>((value >> (8 * b)) & 0xFF);
+    }
+    out.write(std::string_view(bytes, num_bytes));
+}
+
+void _write_column_padding(OutputBuffer& out, uint64_t byte_len) {
+    static const char zeros[COLUMN_ALIGNMENT] = {};
+    out.write(std::string_view(zeros, _aligned_column_len(byte_len) - byte_len));
+}
+
+bool _is_little_endian() {
+    const uint32_t probe = 1;
+    char first_byte;
+    std::memcpy(&first_byte, &probe, 1);
+    return first_byte == 1;
+}
+
+void _write_columnar_header(OutputBuffer& out, int64_t num_rows, const std::vector<_ColumnSpec>& columns) {
+    out.write(std::string_view(COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC)));
+    _write_le(out, COLUMNAR_VERSION, 4);
+    _write_le(out, columns.size(), 4);
+    _write_le(out, num_rows, 8);
+
+    uint64_t offset = _aligned_column_len(24 + columns.size() * COLUMN_ENTRY_SIZE);
+    for (const _ColumnSpec& column : columns) {
+        char name[COLUMN_NAME_SIZE] = {};
+        std::strncpy(name, column.name, COLUMN_NAME_SIZE - 1);
+        out.write(std::string_view(name, COLUMN_NAME_SIZE));
+        _write_le(out, column.type, 4);
+        _write_le(out, 0, 4);
+        _write_le(out, offset, 8);
+        _write_le(out, column.byte_len, 8);
+        offset += _aligned_column_len(column.byte_len);
+    }
+    _write_column_padding(out, 24 + columns.size() * COLUMN_ENTRY_SIZE);
+}
+
+template <typename T>
+void _write_column(OutputBuffer& out, const std::vector<T>& values) {
+    // Column buffer is the vector itself (on a little-endian host)
+    if (_is_little_endian()) {
+        out.write(std::string_view(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T)));
+    } else {
+        for (const T& value : values) {
+            uint64_t bits = 0;
+            std::memcpy(&bits, &value, sizeof(T));
+            _write_le(out, bits, sizeof(T));
+        }
+    }
+    _write_column_padding(out, values.size() * sizeof(T));
+}
+
+void _write_string_column(OutputBuffer& out, const std::vector<std::string>& values) {
+    uint64_t byte_len = 0;
+    for (const std::string& value : values) {
+        out.write(value);
+        out.write('\0');
+        byte_len += value.size() + 1;
+    }
+    _write_column_padding(out, byte_len);
+}
+
+uint64_t _string_column_len(const std::vector<std::string>& values) {
+    uint64_t byte_len = 0;
+    for (const std::string& value : values) {
+        byte_len += value.size() + 1;
+    }
+    return byte_len;
+}
+
+// Flat overlap records: the records of `overlap_collection[i]` for every contig i, in order
+struct _OverlapColumns {
+    std::vector<int> contig_i;
+    std::vector<uint8_t> terminus_i;
+    std::vector<int> contig_j;
+    std::vector<uint8_t> terminus_j;
+    std::vector<int> ovl_len;
+};
+
+_OverlapColumns _collect_overlap_columns(const OverlapCollection& overlap_collection, size_t num_contigs) {
+    // Rows of each contig go to their own slice of the columns, so contigs are processed in parallel
+    std::vector<size_t> counts(num_contigs);
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (size_t i = 0; i < num_contigs; ++i) {
+        counts[i] = overlap_collection[i].size();
+    }
+    std::vector<size_t> offsets;
+    _exclusive_scan(counts, offsets);
+
+    _OverlapColumns columns;
+    size_t num_rows = offsets.back();
+    columns.contig_i.resize(num_rows);
+    columns.terminus_i.resize(num_rows);
+    columns.contig_j.resize(num_rows);
+    columns.terminus_j.resize(num_rows);
+    columns.ovl_len.resize(num_rows);
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (size_t i = 0; i < num_contigs; ++i) {
+        size_t row = offsets[i];
+        for (const Overlap& ovl : overlap_collection[i]) {
+            // Contig numbers are 1-based, as "#" in the adjacency table
+            columns.contig_i[row] = ovl.contig_i + 1;
+            columns.terminus_i[row] = static_cast<uint8_t>(ovl.terminus_i);
+            columns.contig_j[row] = ovl.contig_j + 1;
+            columns.terminus_j[row] = static_cast<uint8_t>(ovl.terminus_j);
+            columns.ovl_len[row] = ovl.ovl_len;
+            row++;
+        }
+    }
+    return columns;
+}
+
+bool _open_columnar_file(std::ofstream& outfile, const std::string& fpath) {
+    outfile.open(fpath, std::ios::binary);
+    if (!outfile.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << fpath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void write_columnar_tables(const ContigCollection& contig_collection, const OverlapCollection& overlap_collection,
+                           const std::string& outdpath) {
+    // Function writes the contig table (`_contigs.bin`) and the overlap table (`_overlaps.bin`).
+    // Termini are coded as `Terminus`: 0 start, 1 rc-start, 2 end, 3 rc-end;
+    // unknown coverage is -1, as in `ContigCollection`.
+    std::string contigs_fpath = outdpath + "_contigs.bin";
+    std::string overlaps_fpath = outdpath + "_overlaps.bin";
+    std::cout << "Writing columnar contig table to `" << contigs_fpath << "`" << std::endl
+              << "Writing columnar overlap table to `" << overlaps_fpath << "`" << std::endl;
+
+    size_t num_contigs = contig_collection.size();
+
+    // Число перекрытий начала и конца каждого контига
+    std::vector<int> start_degrees(num_contigs);
+    std::vector<int> end_degrees(num_contigs);
+    for (size_t i = 0; i < num_contigs; ++i) {
+        start_degrees[i] = overlap_collection.start_degree(i);
+        end_degrees[i] = overlap_collection.end_degree(i);
+    }
+
+    std::ofstream contigs_file;
+    if (!_open_columnar_file(contigs_file, contigs_fpath)) {
+        return;
+    }
+    {
+        OutputBuffer out(contigs_file);
+        uint64_t int_len = num_contigs * sizeof(int);
+        _write_columnar_header(out, num_contigs, {
+            {"name", COLUMN_STRING, _string_column_len(contig_collection.names())},
+            {"length", COLUMN_INT32, int_len},
+            {"coverage", COLUMN_FLOAT32, int_len},
+            {"gc", COLUMN_FLOAT32, int_len},
+            {"multiplicity", COLUMN_INT32, int_len},
+            {"start_degree", COLUMN_INT32, int_len},
+            {"end_degree", COLUMN_INT32, int_len}
+        });
+        _write_string_column(out, contig_collection.names());
+        _write_column(out, contig_collection.lengths());
+        _write_column(out, contig_collection.covs());
+        _write_column(out, contig_collection.gc_contents());
+        _write_column(out, contig_collection.multiplicities());
+        _write_column(out, start_degrees);
+        _write_column(out, end_degrees);
+    }
+    contigs_file.close();
+
+    std::ofstream overlaps_file;
+    if (!_open_columnar_file(overlaps_file, overlaps_fpath)) {
+        return;
+    }
+    {
+        _OverlapColumns columns = _collect_overlap_columns(overlap_collection, num_contigs);
+        size_t num_rows = columns.ovl_len.size();
+        OutputBuffer out(overlaps_file);
+        _write_columnar_header(out, num_rows, {
+            {"contig_i", COLUMN_INT32, num_rows * sizeof(int)},
+            {"terminus_i", COLUMN_UINT8, num_rows},
+            {"contig_j", COLUMN_INT32, num_rows * sizeof(int)},
+            {"terminus_j", COLUMN_UINT8, num_rows},
+            {"ovl_len", COLUMN_INT32, num_rows * sizeof(int)}
+        });
+        _write_column(out, columns.contig_i);
+        _write_column(out, columns.terminus_i);
+        _write_column(out, columns.contig_j);
+        _write_column(out, columns.terminus_j);
+        _write_column(out, columns.ovl_len);
+    }
+    overlaps_file.close();
+}
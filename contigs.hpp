@@ -2,18 +2,22 @@
 
 #include <string>
 #include <vector>
-#include <tuple>
 #include <unordered_map> 
 #include <fstream>
+#include <algorithm>
+#include <string_view>
+#include <iterator>
+#include <type_traits>
 
-using namespace std;
+#include "fasta_reader.hpp"
+#include "sequence_kernels.hpp"
+#include "packed_termini.hpp"
 
-std::unordered_map<char, char> _COMPL_DICT = {
-    {'A', 'T'}, {'T', 'A'}, {'G', 'C'}, {'C', 'G'},
-    {'R', 'Y'}, {'Y', 'R'}, {'S', 'S'}, {'W', 'W'},
-    {'K', 'M'}, {'M', 'K'}, {'B', 'V'}, {'D', 'H'},
-    {'H', 'D'}, {'V', 'B'}, {'U', 'A'}, {'N', 'N'}
-};
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
 
 class Contig {
 public:
@@ -24,7 +28,7 @@ public:
            const std::string& end, const std::string& rcend) :
            name(name), length(length), cov(cov),
            gc_content(gc_content), start(start),
-           rcstart(rcstart), end(end), rcend(rcend), multplty(0) {}
+           rcstart(rcstart), end(end), rcend(rcend), multplty(0), composition() {}
 
     std::string name;     // Имя
     int length;           // Длина в bp
@@ -35,47 +39,200 @@ public:
     std::string end;      // Суффикс длиной k этого контига
     std::string rcend;    // Обратно-комплементарная строка end
     int multplty;         // Количество копий этого контига в геноме (множество)
+    BaseComposition composition; // Нуклеотидный состав
 };
 
-typedef std::vector<Contig> ContigCollection;
 typedef int ContigIndex;
 
-std::vector<std::tuple<std::string, std::string>> fasta_generator(const std::string& filepath) {
-    std::vector<std::tuple<std::string, std::string>> sequences;
-
-    std::string curr_seq_name = "";
-    std::string curr_seq = "";
-
-    std::ifstream file(filepath);
-    std::string line;
-
-    if (file.is_open()) {
-        std::getline(file, curr_seq_name);
-
-        while (std::getline(file, line)) {
-            if (line.empty() || line[0] == '>' || line[0] == '@' ) {
-                // Если строка пустая или начинается с '>', это новая последовательность
-                if (!curr_seq.empty()) {
-                    sequences.push_back(std::make_tuple(curr_seq_name, curr_seq));
-                    curr_seq.clear();
-                }
-                curr_seq_name = line;
-            } else {
-                // Иначе это часть последовательности, добавляем к текущей последовательности
-                curr_seq += line;
-            }
-        }
+template <bool Const>
+struct BasicContigRef {
+    // Lightweight accessor to one row of `ContigTable` with the fields of `Contig`
+    template <typename T>
+    using Field = typename std::conditional<Const, const T&, T&>::type;
+
+    Field<std::string> name;
+    Field<int> length;
+    Field<float> cov;
+    Field<float> gc_content;
+    Field<int> multplty;
+    Field<BaseComposition> composition;
+};
+
+typedef BasicContigRef<false> ContigRef;
+typedef BasicContigRef<true> ConstContigRef;
+
+std::string _rc(std::string_view seq) {
+    std::string result(seq.length(), '\0');
+    reverse_complement(seq, &result[0]);
+    return result;
+}
+
+// Four termini of one contig as strings (see `ContigTable::termini`)
+struct ContigTermini {
+    std::string start;
+    std::string rcstart;
+    std::string end;
+    std::string rcend;
+};
+
+class ContigTable {
+public:
+    // Конструктор класса ContigTable. Таблица контигов в виде структуры массивов:
+    // длины, покрытия, GC и кратности лежат в отдельных непрерывных массивах.
+    // Из терминов хранятся только два канонических (start и rcend), упакованные
+    // по 2 бита на основание (`PackedTermini`); end и rcstart -- их обратные комплементы.
+    // Строки терминов восстанавливаются по запросу (`termini`, `TerminusStrings`);
+    // регистр и основания не из A/C/G/T хранятся рядом с упакованными словами.
+    ContigTable() {}
+
+    size_t size() const { return _lengths.size(); }
+    bool empty() const { return _lengths.empty(); }
+
+    void reserve(size_t num_contigs) {
+        _names.reserve(num_contigs);
+        _lengths.reserve(num_contigs);
+        _covs.reserve(num_contigs);
+        _gc_contents.reserve(num_contigs);
+        _multplties.reserve(num_contigs);
+        _compositions.reserve(num_contigs);
+        _packed.reserve(num_contigs);
+    }
+
+    // Метод добавляет контиг в конец таблицы
+    void push_back(const Contig& contig) {
+        _names.push_back(contig.name);
+        _lengths.push_back(contig.length);
+        _covs.push_back(contig.cov);
+        _gc_contents.push_back(contig.gc_content);
+        _multplties.push_back(contig.multplty);
+        _compositions.push_back(contig.composition);
+        // rcstart и rcend -- обратные комплементы start и end (см. `ContigBuilder`)
+        _packed.push_back(contig.start, contig.end);
+    }
+
+    // Метод переносит в конец таблицы все контиги `other`; `other` остаётся пустой,
+    // её память освобождается
+    void append(ContigTable&& other) {
+        _names.insert(_names.end(), std::make_move_iterator(other._names.begin()),
+                      std::make_move_iterator(other._names.end()));
+        _lengths.insert(_lengths.end(), other._lengths.begin(), other._lengths.end());
+        _covs.insert(_covs.end(), other._covs.begin(), other._covs.end());
+        _gc_contents.insert(_gc_contents.end(), other._gc_contents.begin(), other._gc_contents.end());
+        _multplties.insert(_multplties.end(), other._multplties.begin(), other._multplties.end());
+        _compositions.insert(_compositions.end(), other._compositions.begin(), other._compositions.end());
+        _packed.append(other._packed);
+        other = ContigTable();
+    }
+
+    ContigRef operator[](ContigIndex c) { return _ref<ContigRef>(*this, c); }
+    ConstContigRef operator[](ContigIndex c) const { return _ref<ConstContigRef>(*this, c); }
+    ContigRef back() { return (*this)[size() - 1]; }
+    ConstContigRef back() const { return (*this)[size() - 1]; }
+
+    // Столбцы таблицы
+    const std::vector<std::string>& names() const { return _names; }
+    const std::vector<int>& lengths() const { return _lengths; }
+    const std::vector<float>& covs() const { return _covs; }
+    const std::vector<float>& gc_contents() const { return _gc_contents; }
+    const std::vector<int>& multiplicities() const { return _multplties; }
+    std::vector<int>& multiplicities() { return _multplties; }
+    const std::vector<BaseComposition>& compositions() const { return _compositions; }
+
+    // Упакованный канонический термин контига `c` (STRAND_FORWARD -- start, STRAND_REVERSE -- rcend)
+    PackedTerminus inward(ContigIndex c, int strand) const { return _packed.inward(c, strand); }
+
+    // Длина терминов контига `c`
+    int terminus_length(ContigIndex c) const { return _packed.inward(c, STRAND_FORWARD).length; }
+
+    // Метод восстанавливает четыре строки терминов контига `c`
+    ContigTermini termini(ContigIndex c) const {
+        ContigTermini result;
+        termini(c, result);
+        return result;
+    }
 
-        // Добавляем последнюю последовательность
-        if (!curr_seq.empty()) {
-            sequences.push_back(std::make_tuple(curr_seq_name, curr_seq));
+    // The same into `result`, reusing the capacity of its strings (for per-thread buffers)
+    void termini(ContigIndex c, ContigTermini& result) const {
+        unpack_terminus(_packed.inward(c, STRAND_FORWARD), result.start);
+        unpack_terminus(_packed.inward(c, STRAND_REVERSE), result.end);
+        std::reverse(result.end.begin(), result.end.end());
+        result.rcstart.resize(result.start.length());
+        reverse_complement(result.start, &result.rcstart[0]);
+        result.rcend.resize(result.end.length());
+        reverse_complement(result.end, &result.rcend[0]);
+    }
+
+private:
+    std::vector<std::string> _names;
+    std::vector<int> _lengths;
+    std::vector<float> _covs;
+    std::vector<float> _gc_contents;
+    std::vector<int> _multplties;
+    std::vector<BaseComposition> _compositions;
+    PackedTermini _packed;
+
+    template <typename Ref, typename Table>
+    static Ref _ref(Table& table, ContigIndex c) {
+        return Ref{table._names[c], table._lengths[c], table._covs[c], table._gc_contents[c],
+                   table._multplties[c], table._compositions[c]};
+    }
+};
+
+class TerminusStrings {
+public:
+    // Конструктор класса TerminusStrings: строки четырёх терминов всех контигов таблицы,
+    // восстановленные для поисков, работающих с символами. Строки лежат в общей
+    // выровненной области (start | rcstart | end | rcend), строка контига -- целые
+    // 64-байтные блоки, так что каждая начинается с кэш-линии.
+    explicit TerminusStrings(const ContigTable& table) : _terminus_stride(0), _row_blocks(0) {
+        size_t num_contigs = table.size();
+        _terminus_lens.resize(num_contigs);
+        for (size_t c = 0; c < num_contigs; ++c) {
+            _terminus_lens[c] = table.terminus_length(c);
+            _terminus_stride = std::max(_terminus_stride, _terminus_lens[c]);
         }
+        _row_blocks = (4 * static_cast<size_t>(_terminus_stride) + sizeof(_TerminusBlock) - 1) /
+                      sizeof(_TerminusBlock);
+        _arena.resize(num_contigs * _row_blocks);
+
+        #pragma omp parallel for schedule(dynamic, 1024)
+        for (size_t c = 0; c < num_contigs; ++c) {
+            ContigTermini termini = table.termini(c);
+            char* row = _arena[c * _row_blocks].bytes;
+            size_t len = _terminus_lens[c];
+            // Outer `len` bases: prefixes of start and rcend, suffixes of rcstart and end
+            std::copy(termini.start.begin(), termini.start.begin() + len, row);
+            std::copy(termini.rcstart.end() - len, termini.rcstart.end(), row + _terminus_stride);
+            std::copy(termini.end.end() - len, termini.end.end(), row + 2 * _terminus_stride);
+            std::copy(termini.rcend.begin(), termini.rcend.begin() + len, row + 3 * _terminus_stride);
+        }
+    }
+
+    // Копирование запрещено: строки ссылаются на собственную область
+    TerminusStrings(const TerminusStrings&) = delete;
+    TerminusStrings& operator=(const TerminusStrings&) = delete;
+
+    std::string_view start(ContigIndex c) const { return _terminus(c, 0); }
+    std::string_view rcstart(ContigIndex c) const { return _terminus(c, 1); }
+    std::string_view end(ContigIndex c) const { return _terminus(c, 2); }
+    std::string_view rcend(ContigIndex c) const { return _terminus(c, 3); }
+
+private:
+    struct alignas(64) _TerminusBlock {
+        char bytes[64];
+    };
 
-        file.close();
+    std::vector<int> _terminus_lens;
+    int _terminus_stride;                // место под один термин в строке области
+    size_t _row_blocks;                  // блоков `_TerminusBlock` на строку
+    std::vector<_TerminusBlock> _arena;
+
+    std::string_view _terminus(ContigIndex c, int kind) const {
+        return std::string_view(_arena[c * _row_blocks].bytes + kind * _terminus_stride, _terminus_lens[c]);
     }
+};
 
-    return sequences;
-}
+typedef ContigTable ContigCollection;
 
 std::string format_contig_name(std::string fasta_header) {
     
@@ -92,74 +249,208 @@ std::string format_contig_name(std::string fasta_header) {
     return contig_name;
 }
 
-float calc_gc_сontent(std::string sequence) {
-    int gc_count = 0;
+float calc_gc_сontent(std::string_view sequence) {
+    BaseComposition composition;
+    count_bases(sequence, composition);
+
+    float gc_content = (static_cast<float>(composition.gc_count()) / sequence.length()) * 100;
+
+    return gc_content;
+}
+
+
+class ContigBuilder {
+public:
+    // Конструктор класса ContigBuilder. Собирает `Contig` по строкам последовательности,
+    // храня только первые `maxk` оснований и скользящий суффикс длиной `maxk`.
+    explicit ContigBuilder(int maxk) : _maxk(maxk), _suffix(maxk, ' ') {
+        begin("");
+    }
 
-    for (char base : sequence) {
-        if (base == 'G' || base == 'C' || base == 'S') {
-            gc_count++;
+    // Метод начинает новую запись с заголовком `header`
+    void begin(std::string_view header) {
+        _header.assign(header);
+        _length = 0;
+        _composition = BaseComposition();
+        _start.clear();
+        _suffix_pos = 0;
+    }
+
+    // Метод добавляет очередную строку последовательности (без перевода строки)
+    void add_line(std::string_view line) {
+        if (static_cast<int>(_start.length()) < _maxk) {
+            _start.append(line.substr(0, _maxk - _start.length()));
         }
+        count_bases(line, _composition);
+        _length += line.length();
+        _push_suffix(line);
     }
 
-    float gc_content = (static_cast<float>(gc_count) / sequence.length()) * 100;
+    bool empty() const {
+        return _length == 0;
+    }
 
-    return gc_content;
-}
+    Contig build() const {
+        float gc_content = (static_cast<float>(_composition.gc_count()) / _length) * 100;
+        float cov = 0;
+        std::string end = _get_suffix();
+
+        Contig contig(
+            format_contig_name(_header),
+            _length,
+            cov,
+            gc_content,
+            _start,       // start
+            _rc(_start),  // rcstart
+            end,          // end
+            _rc(end)      // rcend
+        );
+        contig.composition = _composition;
+        return contig;
+    }
+
+private:
+    int _maxk;
+    std::string _header;
+    int _length;
+    BaseComposition _composition;
+    std::string _start;   // первые `maxk` оснований
+    std::string _suffix;  // кольцевой буфер последних `maxk` оснований
+    int _suffix_pos;      // позиция следующей записи в `_suffix`
+
+    void _push_suffix(std::string_view line) {
+        if (_maxk == 0) {
+            return;
+        }
+        if (static_cast<int>(line.length()) >= _maxk) {
+            line.copy(&_suffix[0], _maxk, line.length() - _maxk);
+            _suffix_pos = 0;
+            return;
+        }
+        for (char base : line) {
+            _suffix[_suffix_pos] = base;
+            _suffix_pos = _suffix_pos + 1 == _maxk ? 0 : _suffix_pos + 1;
+        }
+    }
 
-std::string _get_compl_base(char base) {
+    std::string _get_suffix() const {
+        int end_len = std::min(_maxk, _length);
+        if (end_len < _maxk) {
+            // Буфер ещё не заполнен целиком: последовательность лежит с начала
+            return _suffix.substr(0, end_len);
+        }
+        return _suffix.substr(_suffix_pos) + _suffix.substr(0, _suffix_pos);
+    }
+};
 
-    return std::string(1, _COMPL_DICT[base]);
-}
+template <typename Source>
+ContigCollection _stream_contigs(Source& source, int maxk) {
+    // Function builds contigs from a byte source in a single streaming pass.
+    ContigCollection contig_collection;
 
-std::string _rc(const std::string& seq) {
-    std::string result;
-    for (auto it = seq.rbegin(); it != seq.rend(); ++it) {
-        result += _get_compl_base(*it);
+    LineReader<Source> lines(source);
+    ContigBuilder builder(maxk);
+    std::string_view line;
+
+    // The first line is always treated as a header
+    if (lines.next_line(line)) {
+        builder.begin(line);
     }
-    return result;
+    while (lines.next_line(line)) {
+        if (_is_header_line(line)) {
+            if (!builder.empty()) {
+                contig_collection.push_back(builder.build());
+            }
+            builder.begin(line);
+        } else {
+            builder.add_line(line);
+        }
+    }
+    if (!builder.empty()) {
+        contig_collection.push_back(builder.build());
+    }
+    return contig_collection;
 }
 
+ContigCollection stream_contig_collection(const std::string& filepath, int maxk) {
+    // Function reads contigs in a single streaming pass over the file.
+    // Whole sequences are never held in memory: length and GC are accumulated
+    // line by line, and only the first and the last `maxk` bases are kept,
+    // so memory use is O(number of contigs * maxk).
+    // Gzip input is decompressed on the fly; BGZF blocks are decompressed in parallel.
+
+    CompressionFormat format = detect_compression(filepath);
+
+    if (format == BGZF_COMPRESSED) {
+        BgzfSource source(filepath);
+        return _stream_contigs(source, maxk);
+    }
+    if (format == GZIP_COMPRESSED) {
+        GzipSource source(filepath);
+        if (!source.is_open()) {
+            std::cerr << "Error: Unable to open file for reading: " << filepath << std::endl;
+            return ContigCollection();
+        }
+        return _stream_contigs(source, maxk);
+    }
+
+    FileSource file(filepath);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file for reading: " << filepath << std::endl;
+        return ContigCollection();
+    }
+    return _stream_contigs(file, maxk);
+}
 
 ContigCollection get_contig_collection(const std::string& filepath, int maxk) {
-    
-    ContigCollection contig_collection;
 
-    std::string curr_seq_name;
-    std::string curr_seq;
+    // Compressed input cannot be mapped, it is decompressed as a stream instead
+    if (detect_compression(filepath) != PLAIN_TEXT) {
+        return stream_contig_collection(filepath, maxk);
+    }
 
-    // Используем функцию fasta_generator для получения последовательных пар
-    std::vector<std::tuple<std::string, std::string>> contigs = fasta_generator(filepath);
+    ContigCollection contig_collection;
 
-    // Выводим полученные последовательности
-    for (const auto& [contig_header, contig_seq] : contigs) {
+    // Файл отображается в память, записи читаются как срезы без копирования
+    MappedFile file(filepath);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file for reading: " << filepath << std::endl;
+        return contig_collection;
+    }
 
-        std::string contig_name = format_contig_name(contig_header);
-        float cov = 0;
-        float gc_content = calc_gc_сontent(contig_seq);
-
-        if (contig_seq.length() >= maxk){
-            contig_collection.push_back(Contig(
-                contig_name,
-                contig_seq.length(),
-                cov,
-                gc_content,
-                contig_seq.substr(0, maxk), // start
-                _rc(contig_seq.substr(0, maxk)), // rcstart
-                contig_seq.substr(contig_seq.length() - maxk), // end
-                _rc(contig_seq.substr(contig_seq.length() - maxk)) // rcend
-            ));
-        } else {
-            contig_collection.push_back(Contig(
-                contig_name,
-                contig_seq.length(),
-                cov,
-                gc_content,
-                contig_seq.substr(0, maxk), // start
-                _rc(contig_seq.substr(0, maxk)), // rcstart
-                contig_seq, // end
-                _rc(contig_seq) // rcend
-            ));
+    // Split the file into chunks aligned to record boundaries and parse them
+    // on all threads. Chunks are concatenated in file order, so contig indices
+    // do not depend on the number of threads.
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
+    std::vector<std::string_view> chunks = split_fasta_chunks(file.view(), 4 * n_threads);
+    std::vector<ContigTable> chunk_tables(chunks.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        FastaSpanReader reader(chunks[c]);
+        FastaRecord record;
+        ContigBuilder builder(maxk);
+        while (reader.next(record)) {
+            builder.begin(record.header);
+            for_each_sequence_line(record.body, [&](std::string_view line) {
+                builder.add_line(line);
+            });
+            chunk_tables[c].push_back(builder.build());
         }
     }
+
+    // Each chunk is parsed straight into its own table; the tables are moved into
+    // the collection in file order and freed one by one
+    size_t num_contigs = 0;
+    for (const ContigTable& table : chunk_tables) {
+        num_contigs += table.size();
+    }
+    contig_collection.reserve(num_contigs);
+    for (ContigTable& table : chunk_tables) {
+        contig_collection.append(std::move(table));
+    }
     return contig_collection;
 }
\ No newline at end of file
@@ -0,0 +1,546 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+#include <zlib.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+class MappedFile {
+public:
+    // Конструктор класса MappedFile: отображает файл в память только для чтения
+    explicit MappedFile(const std::string& filepath) {
+#ifdef _WIN32
+        _file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (_file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(_file, &file_size)) {
+            return;
+        }
+        _size = static_cast<size_t>(file_size.QuadPart);
+        _is_open = true;
+        if (_size == 0) {
+            return;
+        }
+        _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (_mapping == nullptr) {
+            _is_open = false;
+            return;
+        }
+        _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+        _is_open = _data != nullptr;
+#else
+        int fd = ::open(filepath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            return;
+        }
+        _size = static_cast<size_t>(st.st_size);
+        _is_open = true;
+        if (_size > 0) {
+            void* addr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                _is_open = false;
+            } else {
+                _data = static_cast<const char*>(addr);
+                // Файл читается от начала до конца, подсказываем ядру про read-ahead
+                ::madvise(addr, _size, MADV_SEQUENTIAL);
+            }
+        }
+        // Отображение остаётся валидным после закрытия дескриптора
+        ::close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (_data != nullptr) UnmapViewOfFile(_data);
+        if (_mapping != nullptr) CloseHandle(_mapping);
+        if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+#else
+        if (_data != nullptr) ::munmap(const_cast<char*>(_data), _size);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool is_open() const { return _is_open; }
+
+    // Всё содержимое файла (пустое представление для пустого файла)
+    std::string_view view() const {
+        return _data == nullptr ? std::string_view() : std::string_view(_data, _size);
+    }
+
+private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+    bool _is_open = false;
+#ifdef _WIN32
+    HANDLE _file = INVALID_HANDLE_VALUE;
+    HANDLE _mapping = nullptr;
+#endif
+};
+
+// One FASTA record as spans into the mapped file.
+// `body` holds the raw sequence lines, newlines included;
+// use `for_each_sequence_line` to walk it without copying.
+struct FastaRecord {
+    std::string_view header; // строка заголовка как есть (вместе с '>')
+    std::string_view body;   // строки последовательности вместе с символами перевода строки
+};
+
+// Function returns the line starting at `pos` (without the trailing "\n" or "\r\n")
+// and moves `pos` to the beginning of the next line.
+std::string_view _next_line(std::string_view text, size_t& pos) {
+    const char* begin = text.data() + pos;
+    const char* newline = static_cast<const char*>(std::memchr(begin, '\n', text.size() - pos));
+    size_t line_len = newline == nullptr ? text.size() - pos : static_cast<size_t>(newline - begin);
+
+    pos += newline == nullptr ? line_len : line_len + 1;
+
+    if (line_len > 0 && begin[line_len - 1] == '\r') {
+        --line_len;
+    }
+    return std::string_view(begin, line_len);
+}
+
+bool _is_header_line(std::string_view line) {
+    // Пустая строка или строка, начинающаяся с '>' или '@', открывает новую последовательность
+    return line.empty() || line[0] == '>' || line[0] == '@';
+}
+
+template <typename LineFunc>
+void for_each_sequence_line(std::string_view body, LineFunc func) {
+    // Function calls `func` for every sequence line of a record body,
+    // with newline characters stripped. No data is copied.
+    size_t pos = 0;
+    while (pos < body.size()) {
+        std::string_view line = _next_line(body, pos);
+        if (!line.empty()) {
+            func(line);
+        }
+    }
+}
+
+class FastaSpanReader {
+public:
+    // Конструктор класса FastaSpanReader. `text` должен жить дольше читателя
+    explicit FastaSpanReader(std::string_view text) : _text(text), _pos(0) {
+        // The first line is always treated as a header, like in the old `fasta_generator`
+        if (!_text.empty()) {
+            _header = _next_line(_text, _pos);
+        }
+    }
+
+    // Метод выдаёт следующую запись с непустой последовательностью.
+    // Возвращает false, когда записи закончились.
+    bool next(FastaRecord& record) {
+        size_t body_begin = _pos;
+        size_t body_end = _pos;
+
+        while (_pos < _text.size()) {
+            std::string_view line = _next_line(_text, _pos);
+            if (!_is_header_line(line)) {
+                body_end = _pos;
+                continue;
+            }
+            std::string_view header = _header;
+            _header = line;
+            if (body_end > body_begin) {
+                record = {header, _text.substr(body_begin, body_end - body_begin)};
+                return true;
+            }
+            // Records without sequence lines are skipped
+            body_begin = _pos;
+            body_end = _pos;
+        }
+
+        if (body_end > body_begin) {
+            record = {_header, _text.substr(body_begin, body_end - body_begin)};
+            return true;
+        }
+        return false;
+    }
+
+private:
+    std::string_view _text;
+    std::string_view _header;
+    size_t _pos;
+};
+
+class FileSource {
+public:
+    // Конструктор класса FileSource: источник байтов из обычного файла
+    explicit FileSource(const std::string& filepath) : _file(std::fopen(filepath.c_str(), "rb")) {}
+
+    ~FileSource() {
+        if (_file != nullptr) std::fclose(_file);
+    }
+
+    FileSource(const FileSource&) = delete;
+    FileSource& operator=(const FileSource&) = delete;
+
+    bool is_open() const { return _file != nullptr; }
+
+    // Метод читает до `capacity` байтов, 0 означает конец файла
+    size_t read(char* buffer, size_t capacity) {
+        return std::fread(buffer, 1, capacity, _file);
+    }
+
+private:
+    std::FILE* _file;
+};
+
+template <typename Source>
+class LineReader {
+public:
+    // Конструктор класса LineReader. Читает `source` блоками по `chunk_size` байтов
+    explicit LineReader(Source& source, size_t chunk_size = 1 << 20) :
+        _source(source), _buffer(chunk_size), _begin(0), _end(0), _eof(false) {}
+
+    // Метод выдаёт следующую строку без символов перевода строки.
+    // Представление действительно до следующего вызова.
+    bool next_line(std::string_view& line) {
+        size_t scan_from = _begin;
+        while (true) {
+            const char* newline = static_cast<const char*>(
+                std::memchr(_buffer.data() + scan_from, '\n', _end - scan_from));
+            if (newline != nullptr) {
+                size_t line_end = newline - _buffer.data();
+                line = _trim_cr(_begin, line_end);
+                _begin = line_end + 1;
+                return true;
+            }
+            if (_eof) {
+                if (_begin == _end) {
+                    return false;
+                }
+                line = _trim_cr(_begin, _end);
+                _begin = _end;
+                return true;
+            }
+            scan_from = _end - _begin;
+            _refill();
+        }
+    }
+
+private:
+    Source& _source;
+    std::vector<char> _buffer;
+    size_t _begin; // начало непрочитанных данных в буфере
+    size_t _end;   // конец данных в буфере
+    bool _eof;
+
+    std::string_view _trim_cr(size_t begin, size_t end) const {
+        if (end > begin && _buffer[end - 1] == '\r') {
+            --end;
+        }
+        return std::string_view(_buffer.data() + begin, end - begin);
+    }
+
+    void _refill() {
+        // Move the incomplete line to the front; grow only for lines longer than the buffer
+        std::copy(_buffer.begin() + _begin, _buffer.begin() + _end, _buffer.begin());
+        _end -= _begin;
+        _begin = 0;
+        if (_end == _buffer.size()) {
+            _buffer.resize(_buffer.size() * 2);
+        }
+        size_t n_read = _source.read(_buffer.data() + _end, _buffer.size() - _end);
+        _end += n_read;
+        _eof = n_read == 0;
+    }
+};
+
+std::vector<std::string_view> split_fasta_chunks(std::string_view text, size_t n_chunks,
+                                                 size_t min_chunk_size = 1 << 20) {
+    // Function splits `text` into at most `n_chunks` consecutive byte ranges.
+    // Every range except the first one starts with a line beginning with '>',
+    // so each range can be parsed independently by `FastaSpanReader`
+    // and the records of all ranges, taken in order, are exactly the records of `text`.
+    std::vector<std::string_view> chunks;
+    size_t chunk_size = std::max(min_chunk_size, text.size() / std::max<size_t>(n_chunks, 1) + 1);
+
+    size_t chunk_begin = 0;
+    while (chunk_begin < text.size()) {
+        size_t pos = chunk_begin + chunk_size;
+        size_t chunk_end = text.size();
+
+        // Find the first "\n>" at or after the nominal boundary
+        while (pos < text.size()) {
+            const char* newline = static_cast<const char*>(
+                std::memchr(text.data() + pos - 1, '\n', text.size() - pos + 1));
+            if (newline == nullptr) {
+                break;
+            }
+            size_t line_begin = newline - text.data() + 1;
+            if (line_begin < text.size() && text[line_begin] == '>') {
+                chunk_end = line_begin;
+                break;
+            }
+            pos = line_begin + 1;
+        }
+
+        chunks.push_back(text.substr(chunk_begin, chunk_end - chunk_begin));
+        chunk_begin = chunk_end;
+    }
+    return chunks;
+}
+
+typedef int CompressionFormat;
+const CompressionFormat PLAIN_TEXT = 0;
+const CompressionFormat GZIP_COMPRESSED = 1;
+const CompressionFormat BGZF_COMPRESSED = 2;
+
+CompressionFormat detect_compression(const std::string& filepath) {
+    // Function checks the magic bytes of the file.
+    // BGZF is gzip whose first member carries the "BC" extra subfield with the block size.
+    unsigned char header[18] = {0};
+    size_t n_read = 0;
+    {
+        FileSource file(filepath);
+        if (!file.is_open()) {
+            return PLAIN_TEXT;
+        }
+        n_read = file.read(reinterpret_cast<char*>(header), sizeof(header));
+    }
+
+    if (n_read < 2 || header[0] != 0x1f || header[1] != 0x8b) {
+        return PLAIN_TEXT;
+    }
+    bool has_extra = n_read == sizeof(header) && header[2] == 8 && (header[3] & 4);
+    if (has_extra && header[12] == 'B' && header[13] == 'C' && header[14] == 2 && header[15] == 0) {
+        return BGZF_COMPRESSED;
+    }
+    return GZIP_COMPRESSED;
+}
+
+class GzipSource {
+public:
+    // Конструктор класса GzipSource: потоковая распаковка gzip (в том числе из нескольких членов)
+    explicit GzipSource(const std::string& filepath) : _file(filepath), _input(1 << 16) {
+        std::memset(&_stream, 0, sizeof(_stream));
+        // 15 + 32: максимальное окно и автоопределение заголовка gzip/zlib
+        _is_open = _file.is_open() && inflateInit2(&_stream, 15 + 32) == Z_OK;
+        _done = !_is_open;
+    }
+
+    ~GzipSource() {
+        if (_is_open) inflateEnd(&_stream);
+    }
+
+    GzipSource(const GzipSource&) = delete;
+    GzipSource& operator=(const GzipSource&) = delete;
+
+    bool is_open() const { return _is_open; }
+
+    size_t read(char* buffer, size_t capacity) {
+        _stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        _stream.avail_out = static_cast<uInt>(capacity);
+
+        while (_stream.avail_out > 0 && !_done) {
+            if (_stream.avail_in == 0 && !_fill_input()) {
+                if (_stream.total_in > 0) {
+                    std::cerr << "Error: Unexpected end of gzip input" << std::endl;
+                }
+                _done = true;
+                break;
+            }
+            int ret = inflate(&_stream, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                // Concatenated gzip members: continue with the next one, if any
+                if (_stream.avail_in == 0 && !_fill_input()) {
+                    _done = true;
+                    break;
+                }
+                inflateReset(&_stream);
+            } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                std::cerr << "Error: Corrupted gzip input: " << (_stream.msg ? _stream.msg : "unknown error") << std::endl;
+                _done = true;
+            }
+        }
+        return capacity - _stream.avail_out;
+    }
+
+private:
+    FileSource _file;
+    std::vector<char> _input;
+    z_stream _stream;
+    bool _is_open;
+    bool _done;
+
+    bool _fill_input() {
+        size_t n_read = _file.read(_input.data(), _input.size());
+        _stream.next_in = reinterpret_cast<Bytef*>(_input.data());
+        _stream.avail_in = static_cast<uInt>(n_read);
+        return n_read > 0;
+    }
+};
+
+class BgzfSource {
+public:
+    // Конструктор класса BgzfSource. Блоки BGZF читаются пачками по `blocks_per_batch`
+    // и распаковываются параллельно, данные отдаются в исходном порядке.
+    explicit BgzfSource(const std::string& filepath, size_t blocks_per_batch = 256) :
+        _file(filepath), _blocks(blocks_per_batch), _out_pos(0), _done(!_file.is_open()) {}
+
+    bool is_open() const { return _file.is_open(); }
+
+    size_t read(char* buffer, size_t capacity) {
+        size_t n_copied = 0;
+        while (n_copied < capacity) {
+            if (_out_pos == _out.size() && !_decompress_batch()) {
+                break;
+            }
+            size_t n = std::min(capacity - n_copied, _out.size() - _out_pos);
+            std::memcpy(buffer + n_copied, _out.data() + _out_pos, n);
+            n_copied += n;
+            _out_pos += n;
+        }
+        return n_copied;
+    }
+
+private:
+    FileSource _file;
+    std::vector<std::vector<unsigned char>> _blocks; // сжатые блоки текущей пачки
+    std::vector<char> _out;                          // распакованные данные текущей пачки
+    size_t _out_pos;
+    bool _done;
+
+    bool _read_block(std::vector<unsigned char>& block) {
+        // Function reads one whole BGZF block (header, compressed data and trailer).
+        unsigned char header[12];
+        size_t n_read = _file.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (n_read == 0) {
+            return false;
+        }
+        if (n_read < sizeof(header) || header[0] != 0x1f || header[1] != 0x8b || !(header[3] & 4)) {
+            std::cerr << "Error: Malformed BGZF block header" << std::endl;
+            return false;
+        }
+        size_t xlen = header[10] | (header[11] << 8);
+        std::vector<unsigned char> extra(xlen);
+        if (_file.read(reinterpret_cast<char*>(extra.data()), xlen) < xlen) {
+            std::cerr << "Error: Truncated BGZF block" << std::endl;
+            return false;
+        }
+
+        // Find the "BC" subfield holding the total block size minus one
+        size_t block_size = 0;
+        for (size_t pos = 0; pos + 4 <= xlen; ) {
+            size_t slen = extra[pos + 2] | (extra[pos + 3] << 8);
+            if (extra[pos] == 'B' && extra[pos + 1] == 'C' && slen == 2 && pos + 6 <= xlen) {
+                block_size = (extra[pos + 4] | (extra[pos + 5] << 8)) + 1;
+                break;
+            }
+            pos += 4 + slen;
+        }
+        if (block_size < sizeof(header) + xlen + 8) {
+            std::cerr << "Error: BGZF block without a valid BC subfield" << std::endl;
+            return false;
+        }
+
+        // Keep only the compressed data and the 8-byte trailer (CRC32, ISIZE)
+        size_t rest = block_size - sizeof(header) - xlen;
+        block.resize(rest);
+        if (_file.read(reinterpret_cast<char*>(block.data()), rest) < rest) {
+            std::cerr << "Error: Truncated BGZF block" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool _decompress_batch() {
+        if (_done) {
+            return false;
+        }
+
+        size_t n_blocks = 0;
+        while (n_blocks < _blocks.size() && _read_block(_blocks[n_blocks])) {
+            n_blocks++;
+        }
+        if (n_blocks < _blocks.size()) {
+            _done = true;
+        }
+
+        // Offsets of the decompressed blocks, taken from ISIZE of each trailer
+        std::vector<size_t> offsets(n_blocks + 1, 0);
+        for (size_t b = 0; b < n_blocks; ++b) {
+            const unsigned char* trailer = _blocks[b].data() + _blocks[b].size() - 8;
+            uint32_t isize = trailer[4] | (trailer[5] << 8) | (trailer[6] << 16) | (uint32_t(trailer[7]) << 24);
+            offsets[b + 1] = offsets[b] + isize;
+        }
+        _out.resize(offsets[n_blocks]);
+        _out_pos = 0;
+
+        bool failed = false;
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t b = 0; b < n_blocks; ++b) {
+            if (!_inflate_block(_blocks[b], _out.data() + offsets[b], offsets[b + 1] - offsets[b])) {
+                #pragma omp atomic write
+                failed = true;
+            }
+        }
+        if (failed) {
+            std::cerr << "Error: Corrupted BGZF block" << std::endl;
+            _out.clear();
+            _done = true;
+            return false;
+        }
+        return n_blocks > 0;
+    }
+
+    static bool _inflate_block(const std::vector<unsigned char>& block, char* out, size_t out_size) {
+        // Raw deflate data, the gzip header was already stripped in `_read_block`
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, -15) != Z_OK) {
+            return false;
+        }
+        stream.next_in = const_cast<Bytef*>(block.data());
+        stream.avail_in = static_cast<uInt>(block.size() - 8);
+        // An empty block (such as the EOF marker) may get a null `out`, which `inflate` refuses
+        Bytef empty_out = 0;
+        stream.next_out = out_size == 0 ? &empty_out : reinterpret_cast<Bytef*>(out);
+        stream.avail_out = static_cast<uInt>(out_size);
+        int ret = inflate(&stream, Z_FINISH);
+        inflateEnd(&stream);
+        if (ret != Z_STREAM_END || stream.avail_out != 0) {
+            return false;
+        }
+
+        const unsigned char* trailer = block.data() + block.size() - 8;
+        uint32_t crc = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | (uint32_t(trailer[3]) << 24);
+        return crc32(0L, reinterpret_cast<const Bytef*>(out), static_cast<uInt>(out_size)) == crc;
+    }
+};
@@ -6,6 +6,7 @@
 #include "overlaps.hpp"
 #include "assign_multiplicity.hpp"
 #include "output.hpp"
+#include "assembly_graph.hpp"
 
 using namespace std;
 
@@ -16,9 +17,24 @@ int main() {
     std::string filepath = "C:/Users/admin/Downloads/testg.fasta";
     int maxk=50;
     int mink=5;
+    bool verify_graph = false; // выборочно проверять смежности из графа сборки
+    int exact_k = 0;           // k сборки де Брёйна (> 0: искать только перекрытия длины ровно k)
     
-    // Получение коллекции контигов
-    ContigCollection contig_collection = get_contig_collection(filepath, maxk);
+    ContigCollection contig_collection;
+    OverlapCollection overlap_collection;
+
+    // GFA/FASTG уже содержат смежности контигов: поиск перекрытий не нужен.
+    // Для FASTG длина перекрытия равна k сборки, здесь это maxk.
+    const bool is_graph = is_assembly_graph(filepath);
+    if (is_graph) {
+        load_assembly_graph(filepath, maxk, maxk, contig_collection, overlap_collection);
+        if (verify_graph) {
+            verify_graph_overlaps(contig_collection, overlap_collection);
+        }
+    } else {
+        // Получение коллекции контигов
+        contig_collection = get_contig_collection(filepath, std::max(maxk, exact_k));
+    }
 
     /*for (const auto& contig : contig_collection) {
         std::cout << "Contig Name: " << contig.name << std::endl;
@@ -34,7 +50,18 @@ int main() {
     }*/
 
 
-    OverlapCollection overlap_collection = detect_adjacent_contigs(contig_collection, mink, maxk);
+    if (!is_graph) {
+        std::vector<SearchThreadStats> thread_stats;
+        overlap_collection = exact_k > 0
+            ? detect_adjacent_contigs_exact_k(contig_collection, exact_k)
+            : detect_adjacent_contigs(contig_collection, mink, maxk, &thread_stats);
+
+        // Загрузка потоков при поиске всех пар
+        for (size_t t = 0; t < thread_stats.size(); ++t) {
+            std::cout << "Thread " << t << ": busy " << thread_stats[t].busy_seconds << " s, "
+                      << thread_stats[t].own_tiles << " tiles + " << thread_stats[t].stolen_tiles << " stolen" << std::endl;
+        }
+    }
     
     /*for (const auto& pair : overlap_collection) {
         std::cout << "Key: " << pair.first << ", Value: ";
@@ -56,11 +83,8 @@ int main() {
     assign_multiplicity(contig_collection, overlap_collection);
 
     std::string outdpath = "output";
-    write_summary(contig_collection, overlap_collection, filepath, outdpath);
-
-    write_adjacency_table_and_full_log(contig_collection, overlap_collection, outdpath);
-
-    write_genbank(contig_collection, overlap_collection, outdpath);
+    // Summary, adjacency table, full log and GenBank file in one pass
+    write_outputs(contig_collection, overlap_collection, filepath, outdpath);
 
 
     //write_full_log(contig_collection, overlap_collection, outdpath);
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CONTIGR_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Sequence kernels over views: reverse complement (written into caller-provided buffers)
+// and base composition. On x86 the SSE/AVX2 paths are selected at run time,
+// everything else uses the tables.
+
+// Complements of the characters 0x40..0x5F ('@', 'A'..'Z', '['..'_').
+// IUPAC codes map to their complementary codes, anything else to 'N'.
+constexpr char _LETTER_COMPL[32] = {
+    'N', 'T', 'V', 'G', 'H', 'N', 'N', 'C',   // @ A B C D E F G
+    'D', 'N', 'N', 'M', 'N', 'K', 'N', 'N',   // H I J K L M N O
+    'N', 'N', 'Y', 'S', 'A', 'A', 'B', 'W',   // P Q R S T U V W
+    'N', 'R', 'N', 'N', 'N', 'N', 'N', 'N'    // X Y Z [ \ ] ^ _
+};
+
+constexpr char _compl_base(unsigned char base) {
+    // Function returns the complementary base; the case of the letter is kept.
+    unsigned char folded = base & 0xDF;
+    if ((folded & 0xF0) != 0x40 && (folded & 0xF0) != 0x50) {
+        return 'N';
+    }
+    return static_cast<char>(_LETTER_COMPL[folded & 0x1F] | (base & 0x20));
+}
+
+constexpr std::array<char, 256> _make_compl_table() {
+    std::array<char, 256> table{};
+    for (int base = 0; base < 256; ++base) {
+        table[base] = _compl_base(static_cast<unsigned char>(base));
+    }
+    return table;
+}
+
+constexpr std::array<char, 256> _COMPL_TABLE = _make_compl_table();
+
+#ifdef CONTIGR_X86_SIMD
+
+bool _cpu_has_ssse3() {
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    return has_ssse3;
+}
+
+bool _cpu_has_sse42() {
+    static const bool has_sse42 = __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+    return has_sse42;
+}
+
+bool _cpu_has_avx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+
+// The vector paths evaluate `_compl_base` for 16 (32) bytes at once: the letter
+// complement is looked up by the low nibble in two 16-entry halves of `_LETTER_COMPL`.
+
+__attribute__((target("ssse3")))
+__m128i _compl_16(__m128i seq) {
+    const __m128i lower_half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_LETTER_COMPL));
+    const __m128i upper_half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_LETTER_COMPL + 16));
+    __m128i folded = _mm_and_si128(seq, _mm_set1_epi8(static_cast<char>(0xDF)));
+    __m128i high = _mm_and_si128(folded, _mm_set1_epi8(static_cast<char>(0xF0)));
+    __m128i low = _mm_and_si128(folded, _mm_set1_epi8(0x0F));
+    __m128i is_upper_half = _mm_cmpeq_epi8(high, _mm_set1_epi8(0x50));
+    __m128i is_letter = _mm_or_si128(_mm_cmpeq_epi8(high, _mm_set1_epi8(0x40)), is_upper_half);
+
+    __m128i compl_base = _mm_or_si128(
+        _mm_and_si128(is_upper_half, _mm_shuffle_epi8(upper_half, low)),
+        _mm_andnot_si128(is_upper_half, _mm_shuffle_epi8(lower_half, low)));
+    compl_base = _mm_or_si128(compl_base, _mm_and_si128(seq, _mm_set1_epi8(0x20)));
+    return _mm_or_si128(_mm_and_si128(is_letter, compl_base),
+                        _mm_andnot_si128(is_letter, _mm_set1_epi8('N')));
+}
+
+__attribute__((target("ssse3")))
+size_t _reverse_complement_ssse3(const char* seq, size_t len, char* out) {
+    const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    size_t done = 0;
+    for (; done + 16 <= len; done += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(seq + len - done - 16));
+        block = _compl_16(_mm_shuffle_epi8(block, reverse));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + done), block);
+    }
+    return done;
+}
+
+__attribute__((target("avx2")))
+size_t _reverse_complement_avx2(const char* seq, size_t len, char* out) {
+    const __m256i lower_half = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(_LETTER_COMPL)));
+    const __m256i upper_half = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(_LETTER_COMPL + 16)));
+    const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    size_t done = 0;
+    for (; done + 32 <= len; done += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(seq + len - done - 32));
+        // Reverse bytes inside each 128-bit lane, then swap the lanes
+        block = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(block, reverse), 0x4E);
+
+        __m256i folded = _mm256_and_si256(block, _mm256_set1_epi8(static_cast<char>(0xDF)));
+        __m256i high = _mm256_and_si256(folded, _mm256_set1_epi8(static_cast<char>(0xF0)));
+        __m256i low = _mm256_and_si256(folded, _mm256_set1_epi8(0x0F));
+        __m256i is_upper_half = _mm256_cmpeq_epi8(high, _mm256_set1_epi8(0x50));
+        __m256i is_letter = _mm256_or_si256(_mm256_cmpeq_epi8(high, _mm256_set1_epi8(0x40)), is_upper_half);
+
+        __m256i compl_base = _mm256_blendv_epi8(_mm256_shuffle_epi8(lower_half, low),
+                                                _mm256_shuffle_epi8(upper_half, low), is_upper_half);
+        compl_base = _mm256_or_si256(compl_base, _mm256_and_si256(block, _mm256_set1_epi8(0x20)));
+        block = _mm256_blendv_epi8(_mm256_set1_epi8('N'), compl_base, is_letter);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + done), block);
+    }
+    return done;
+}
+
+#endif
+
+void reverse_complement(std::string_view seq, char* out) {
+    // Function writes the reverse complement of `seq` into `out`
+    // (at least `seq.length()` chars, must not overlap `seq`).
+    size_t len = seq.length();
+    size_t done = 0;
+#ifdef CONTIGR_X86_SIMD
+    if (len >= 32 && _cpu_has_avx2()) {
+        done = _reverse_complement_avx2(seq.data(), len, out);
+    } else if (len >= 16 && _cpu_has_ssse3()) {
+        done = _reverse_complement_ssse3(seq.data(), len, out);
+    }
+#endif
+    for (; done < len; ++done) {
+        out[done] = _COMPL_TABLE[static_cast<unsigned char>(seq[len - 1 - done])];
+    }
+}
+
+struct BaseComposition {
+    // Base counts of a sequence; A/C/G/T/N/S and IUPAC codes are counted in both cases
+    uint64_t a = 0;
+    uint64_t c = 0;
+    uint64_t g = 0;
+    uint64_t t = 0;
+    uint64_t n = 0;
+    uint64_t s = 0;           // S (G или C)
+    uint64_t iupac = 0;       // прочие коды IUPAC: R, Y, W, K, M, B, D, H, V, U
+    uint64_t unknown = 0;     // символы, не являющиеся кодами IUPAC
+    uint64_t soft_masked = 0; // коды IUPAC в нижнем регистре
+
+    void add(const BaseComposition& other) {
+        a += other.a; c += other.c; g += other.g; t += other.t; n += other.n; s += other.s;
+        iupac += other.iupac; unknown += other.unknown; soft_masked += other.soft_masked;
+    }
+
+    uint64_t total() const { return a + c + g + t + n + s + iupac + unknown; }
+    uint64_t gc_count() const { return g + c + s; }
+
+    // Доля оснований N и доля оснований в нижнем регистре
+    float n_fraction() const { return total() == 0 ? 0.0f : static_cast<float>(n) / total(); }
+    float soft_masked_fraction() const { return total() == 0 ? 0.0f : static_cast<float>(soft_masked) / total(); }
+};
+
+// Composition classes of the characters 0x40..0x5F, in the order of the first
+// seven `BaseComposition` counters: 0=A, 1=C, 2=G, 3=T, 4=N, 5=S, 6=IUPAC, 7=unknown.
+constexpr unsigned char _LETTER_CLASS[32] = {
+    7, 0, 6, 1, 6, 7, 7, 2,   // @ A B C D E F G
+    6, 7, 7, 6, 7, 6, 4, 7,   // H I J K L M N O
+    7, 7, 6, 5, 3, 6, 6, 6,   // P Q R S T U V W
+    7, 6, 7, 7, 7, 7, 7, 7    // X Y Z [ \ ] ^ _
+};
+const int _UNKNOWN_CLASS = 7;
+
+constexpr unsigned char _base_class(unsigned char base) {
+    unsigned char folded = base & 0xDF;
+    if ((folded & 0xF0) != 0x40 && (folded & 0xF0) != 0x50) {
+        return _UNKNOWN_CLASS;
+    }
+    return _LETTER_CLASS[folded & 0x1F];
+}
+
+void _add_class_counts(const uint64_t (&counts)[8], uint64_t soft_masked, BaseComposition& composition) {
+    composition.a += counts[0];
+    composition.c += counts[1];
+    composition.g += counts[2];
+    composition.t += counts[3];
+    composition.n += counts[4];
+    composition.s += counts[5];
+    composition.iupac += counts[6];
+    composition.unknown += counts[7];
+    composition.soft_masked += soft_masked;
+}
+
+size_t _count_bases_scalar(const char* seq, size_t len, BaseComposition& composition) {
+    uint64_t counts[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    uint64_t soft_masked = 0;
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char base = static_cast<unsigned char>(seq[i]);
+        unsigned char base_class = _base_class(base);
+        counts[base_class]++;
+        soft_masked += base_class != _UNKNOWN_CLASS && (base & 0x20) != 0;
+    }
+    _add_class_counts(counts, soft_masked, composition);
+    return len;
+}
+
+#ifdef CONTIGR_X86_SIMD
+
+__attribute__((target("sse4.2,popcnt")))
+size_t _count_bases_sse42(const char* seq, size_t len, BaseComposition& composition) {
+    const __m128i lower_half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_LETTER_CLASS));
+    const __m128i upper_half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_LETTER_CLASS + 16));
+    uint64_t counts[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    uint64_t soft_masked = 0;
+    size_t done = 0;
+    for (; done + 16 <= len; done += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(seq + done));
+        __m128i folded = _mm_and_si128(block, _mm_set1_epi8(static_cast<char>(0xDF)));
+        __m128i high = _mm_and_si128(folded, _mm_set1_epi8(static_cast<char>(0xF0)));
+        __m128i low = _mm_and_si128(folded, _mm_set1_epi8(0x0F));
+        __m128i is_upper_half = _mm_cmpeq_epi8(high, _mm_set1_epi8(0x50));
+        __m128i is_letter = _mm_or_si128(_mm_cmpeq_epi8(high, _mm_set1_epi8(0x40)), is_upper_half);
+
+        __m128i base_class = _mm_blendv_epi8(_mm_shuffle_epi8(lower_half, low),
+                                             _mm_shuffle_epi8(upper_half, low), is_upper_half);
+        base_class = _mm_blendv_epi8(_mm_set1_epi8(_UNKNOWN_CLASS), base_class, is_letter);
+        for (int k = 0; k < _UNKNOWN_CLASS; ++k) {
+            counts[k] += _mm_popcnt_u32(_mm_movemask_epi8(_mm_cmpeq_epi8(base_class, _mm_set1_epi8(k))));
+        }
+        __m128i is_code = _mm_andnot_si128(_mm_cmpeq_epi8(base_class, _mm_set1_epi8(_UNKNOWN_CLASS)),
+                                           _mm_set1_epi8(static_cast<char>(0xFF)));
+        __m128i is_lower = _mm_cmpeq_epi8(_mm_and_si128(block, _mm_set1_epi8(0x20)), _mm_set1_epi8(0x20));
+        soft_masked += _mm_popcnt_u32(_mm_movemask_epi8(_mm_and_si128(is_code, is_lower)));
+    }
+    uint64_t num_codes = 0;
+    for (int k = 0; k < _UNKNOWN_CLASS; ++k) {
+        num_codes += counts[k];
+    }
+    counts[_UNKNOWN_CLASS] = done - num_codes;
+    _add_class_counts(counts, soft_masked, composition);
+    return done;
+}
+
+__attribute__((target("avx2,popcnt")))
+size_t _count_bases_avx2(const char* seq, size_t len, BaseComposition& composition) {
+    const __m256i lower_half = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(_LETTER_CLASS)));
+    const __m256i upper_half = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(_LETTER_CLASS + 16)));
+    uint64_t counts[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    uint64_t soft_masked = 0;
+    size_t done = 0;
+    for (; done + 32 <= len; done += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(seq + done));
+        __m256i folded = _mm256_and_si256(block, _mm256_set1_epi8(static_cast<char>(0xDF)));
+        __m256i high = _mm256_and_si256(folded, _mm256_set1_epi8(static_cast<char>(0xF0)));
+        __m256i low = _mm256_and_si256(folded, _mm256_set1_epi8(0x0F));
+        __m256i is_upper_half = _mm256_cmpeq_epi8(high, _mm256_set1_epi8(0x50));
+        __m256i is_letter = _mm256_or_si256(_mm256_cmpeq_epi8(high, _mm256_set1_epi8(0x40)), is_upper_half);
+
+        __m256i base_class = _mm256_blendv_epi8(_mm256_shuffle_epi8(lower_half, low),
+                                                _mm256_shuffle_epi8(upper_half, low), is_upper_half);
+        base_class = _mm256_blendv_epi8(_mm256_set1_epi8(_UNKNOWN_CLASS), base_class, is_letter);
+        for (int k = 0; k < _UNKNOWN_CLASS; ++k) {
+            counts[k] += _mm_popcnt_u32(static_cast<unsigned>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(base_class, _mm256_set1_epi8(k)))));
+        }
+        __m256i is_code = _mm256_andnot_si256(_mm256_cmpeq_epi8(base_class, _mm256_set1_epi8(_UNKNOWN_CLASS)),
+                                              _mm256_set1_epi8(static_cast<char>(0xFF)));
+        __m256i is_lower = _mm256_cmpeq_epi8(_mm256_and_si256(block, _mm256_set1_epi8(0x20)),
+                                             _mm256_set1_epi8(0x20));
+        soft_masked += _mm_popcnt_u32(static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_and_si256(is_code, is_lower))));
+    }
+    uint64_t num_codes = 0;
+    for (int k = 0; k < _UNKNOWN_CLASS; ++k) {
+        num_codes += counts[k];
+    }
+    counts[_UNKNOWN_CLASS] = done - num_codes;
+    _add_class_counts(counts, soft_masked, composition);
+    return done;
+}
+
+#endif
+
+void count_bases(std::string_view seq, BaseComposition& composition) {
+    // Function adds the base counts of `seq` to `composition` in a single pass.
+    size_t done = 0;
+#ifdef CONTIGR_X86_SIMD
+    if (_cpu_has_avx2()) {
+        done = _count_bases_avx2(seq.data(), seq.length(), composition);
+    } else if (_cpu_has_sse42()) {
+        done = _count_bases_sse42(seq.data(), seq.length(), composition);
+    }
+#endif
+    _count_bases_scalar(seq.data() + done, seq.length() - done, composition);
+}